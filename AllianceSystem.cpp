@@ -1,28 +1,63 @@
 #include "MultiplayerSystems.h"
 
+// Left alone, trust drifts back to where a new alliance starts, one point
+// every few turns. The drift is worked out when the trust is looked at,
+// from the turn it was last brought up to date
+const int TRUST_BASELINE = 50;
+const int TURNS_PER_TRUST_POINT = 3;
+
 AllianceSystem::AllianceSystem() : allianceCount(0) {
     allianceLog.open("alliances_log.txt", ios::app);
 }
 
-bool AllianceSystem::formAlliance(const string& kingdom1, const string& kingdom2) {
-    if (allianceCount >= MAX_ALLIANCES) {
-        cout << "Maximum number of alliances reached!" << endl;
-        return false;
+// Trust after drifting toward the baseline since the alliance was last
+// touched. turnsUsed is how many of those turns the drift accounts for
+int AllianceSystem::driftedTrust(const Alliance& alliance, int& turnsUsed) const {
+    int turns = GameClock::now() - alliance.lastTouchedTurn;
+    int gap = alliance.trustLevel - TRUST_BASELINE;
+    if (turns <= 0 || gap == 0) {
+        turnsUsed = turns > 0 ? turns : 0;
+        return alliance.trustLevel;
+    }
+    int drift = turns / TURNS_PER_TRUST_POINT;
+    int distance = gap > 0 ? gap : -gap;
+    if (drift >= distance) {
+        turnsUsed = turns;
+        return TRUST_BASELINE;
     }
+    turnsUsed = drift * TURNS_PER_TRUST_POINT;
+    return gap > 0 ? alliance.trustLevel - drift : alliance.trustLevel + drift;
+}
 
+bool AllianceSystem::formAlliance(const string& kingdom1, const string& kingdom2) {
+    TRACE_SCOPE("AllianceSystem::formAlliance");
+    ALLOCATION_SCOPE(SUBSYSTEM_ALLIANCE);
     for (int i = 0; i < allianceCount; i++) {
         if ((alliances[i].kingdom1 == kingdom1 && alliances[i].kingdom2 == kingdom2) ||
             (alliances[i].kingdom1 == kingdom2 && alliances[i].kingdom2 == kingdom1)) {
+            if (!alliances[i].isActive) {
+                // A broken alliance is renewed with the trust it was left at
+                alliances[i].isActive = true;
+                allianceLog << "Alliance renewed between " << kingdom1 << " and " << kingdom2 << endl;
+                allianceLog.flush();
+                return true;
+            }
             cout << "Alliance already exists between " << kingdom1 << " and " << kingdom2 << endl;
             return false;
         }
     }
 
+    if (allianceCount >= MAX_ALLIANCES) {
+        cout << "Maximum number of alliances reached!" << endl;
+        return false;
+    }
+
     // Create new alliance
     alliances[allianceCount].kingdom1 = kingdom1;
     alliances[allianceCount].kingdom2 = kingdom2;
-    alliances[allianceCount].trustLevel = 50;
+    alliances[allianceCount].trustLevel = TRUST_BASELINE;
     alliances[allianceCount].isActive = true;
+    alliances[allianceCount].lastTouchedTurn = GameClock::now();
 
     allianceLog << "Alliance formed between " << kingdom1 << " and " << kingdom2 << endl;
     allianceLog.flush();
@@ -32,6 +67,8 @@ bool AllianceSystem::formAlliance(const string& kingdom1, const string& kingdom2
 }
 
 bool AllianceSystem::breakAlliance(const string& kingdom1, const string& kingdom2) {
+    TRACE_SCOPE("AllianceSystem::breakAlliance");
+    ALLOCATION_SCOPE(SUBSYSTEM_ALLIANCE);
     for (int i = 0; i < allianceCount; i++) {
         if ((alliances[i].kingdom1 == kingdom1 && alliances[i].kingdom2 == kingdom2) ||
             (alliances[i].kingdom1 == kingdom2 && alliances[i].kingdom2 == kingdom1)) {
@@ -54,10 +91,17 @@ bool AllianceSystem::breakAlliance(const string& kingdom1, const string& kingdom
 }
 
 void AllianceSystem::updateTrustLevel(const string& kingdom1, const string& kingdom2, int change) {
+    TRACE_SCOPE("AllianceSystem::updateTrustLevel");
+    ALLOCATION_SCOPE(SUBSYSTEM_ALLIANCE);
     for (int i = 0; i < allianceCount; i++) {
         if ((alliances[i].kingdom1 == kingdom1 && alliances[i].kingdom2 == kingdom2) ||
             (alliances[i].kingdom1 == kingdom2 && alliances[i].kingdom2 == kingdom1)) {
             
+            // Catch up on the drift first; turns not yet worth a whole
+            // point are kept for next time
+            int turnsUsed;
+            alliances[i].trustLevel = driftedTrust(alliances[i], turnsUsed);
+            alliances[i].lastTouchedTurn += turnsUsed;
             alliances[i].trustLevel += change;
             
             if (alliances[i].trustLevel > 100) alliances[i].trustLevel = 100;
@@ -73,6 +117,8 @@ void AllianceSystem::updateTrustLevel(const string& kingdom1, const string& king
 }
 
 bool AllianceSystem::areAllied(const string& kingdom1, const string& kingdom2) {
+    TRACE_SCOPE("AllianceSystem::areAllied");
+    ALLOCATION_SCOPE(SUBSYSTEM_ALLIANCE);
     for (int i = 0; i < allianceCount; i++) {
         if ((alliances[i].kingdom1 == kingdom1 && alliances[i].kingdom2 == kingdom2) ||
             (alliances[i].kingdom1 == kingdom2 && alliances[i].kingdom2 == kingdom1)) {
@@ -83,13 +129,16 @@ bool AllianceSystem::areAllied(const string& kingdom1, const string& kingdom2) {
 }
 
 void AllianceSystem::saveAlliancesToFile() const {
+    TRACE_SCOPE("AllianceSystem::saveAlliancesToFile");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
     ofstream saveFile("alliances_save.txt");
     if (saveFile.is_open()) {
         saveFile << allianceCount << endl;
         for (int i = 0; i < allianceCount; i++) {
+            int turnsUsed;
             saveFile << alliances[i].kingdom1 << endl;
             saveFile << alliances[i].kingdom2 << endl;
-            saveFile << alliances[i].trustLevel << endl;
+            saveFile << driftedTrust(alliances[i], turnsUsed) << endl;
             saveFile << alliances[i].isActive << endl;
         }
         saveFile.close();
@@ -97,25 +146,32 @@ void AllianceSystem::saveAlliancesToFile() const {
 }
 
 void AllianceSystem::loadAlliancesFromFile() {
+    TRACE_SCOPE("AllianceSystem::loadAlliancesFromFile");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
     ifstream loadFile("alliances_save.txt");
     if (loadFile.is_open()) {
         loadFile >> allianceCount;
         for (int i = 0; i < allianceCount; i++) {
-            loadFile >> alliances[i].kingdom1;
-            loadFile >> alliances[i].kingdom2;
+            // Kingdom names may have spaces, so they take a whole line
+            getline(loadFile >> ws, alliances[i].kingdom1);
+            getline(loadFile >> ws, alliances[i].kingdom2);
             loadFile >> alliances[i].trustLevel;
             loadFile >> alliances[i].isActive;
+            alliances[i].lastTouchedTurn = GameClock::now();
         }
         loadFile.close();
     }
 }
 
 int AllianceSystem::getTrustLevel(const string& kingdom1, const string& kingdom2) const {
+    TRACE_SCOPE("AllianceSystem::getTrustLevel");
+    ALLOCATION_SCOPE(SUBSYSTEM_ALLIANCE);
     for (int i = 0; i < allianceCount; i++) {
         if ((alliances[i].kingdom1 == kingdom1 && alliances[i].kingdom2 == kingdom2) ||
             (alliances[i].kingdom1 == kingdom2 && alliances[i].kingdom2 == kingdom1)) {
-            return alliances[i].trustLevel;
+            int turnsUsed;
+            return driftedTrust(alliances[i], turnsUsed);
         }
     }
-    return 50; 
+    return TRUST_BASELINE; 
 } 
\ No newline at end of file
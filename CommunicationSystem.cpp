@@ -6,6 +6,8 @@ CommunicationSystem::CommunicationSystem() : messageCount(0) {
 
 void CommunicationSystem::sendMessage(const string& sender, const string& receiver, 
                                     const string& content, MessageType type) {
+    TRACE_SCOPE("CommunicationSystem::sendMessage");
+    ALLOCATION_SCOPE(SUBSYSTEM_MESSAGES);
     if (messageCount >= MAX_MESSAGES) {
         cout << "Message system is full!" << endl;
         return;
@@ -22,9 +24,11 @@ void CommunicationSystem::sendMessage(const string& sender, const string& receiv
     messageLog.flush();
 
     messageCount++;
+    Metrics::increment(METRIC_MESSAGES_SENT);
 }
 
 void CommunicationSystem::displayMessages(const string& kingdom) {
+    ALLOCATION_SCOPE(SUBSYSTEM_MESSAGES);
     cout << "\n=== Messages for Kingdom: " << kingdom << " ===\n";
     bool hasMessages = false;
 
@@ -63,6 +67,8 @@ void CommunicationSystem::displayMessages(const string& kingdom) {
 }
 
 void CommunicationSystem::saveMessagesToFile() const {
+    TRACE_SCOPE("CommunicationSystem::saveMessagesToFile");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
     ofstream saveFile("messages_save.txt");
     if (saveFile.is_open()) {
         saveFile << messageCount << endl;
@@ -78,6 +84,8 @@ void CommunicationSystem::saveMessagesToFile() const {
 }
 
 void CommunicationSystem::loadMessagesFromFile() {
+    TRACE_SCOPE("CommunicationSystem::loadMessagesFromFile");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
     ifstream loadFile("messages_save.txt");
     if (loadFile.is_open()) {
         loadFile >> messageCount;
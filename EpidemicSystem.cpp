@@ -0,0 +1,195 @@
+#include "MultiplayerSystems.h"
+
+// Rows processed together; each band only reads the rows next to it, so
+// bands stay in cache and could be handed to separate workers
+const int EPIDEMIC_TILE_ROWS = 32;
+
+// A cell still carries the plague while this much of it is exposed or
+// infected
+const float EPIDEMIC_CARRIER_SHARE = 0.0001f;
+
+EpidemicSystem::EpidemicSystem(int mapWidth, int mapHeight)
+    : width(0), height(0), stride(0), steppedTurn(0), carrierCells(0),
+      transmissionRate(0.6f), incubationRate(0.35f), recoveryRate(0.2f),
+      mortalityRate(0.03f), spreadRate(0.15f) {
+    resize(mapWidth, mapHeight);
+}
+
+// Cells are stored with a one-cell zero border so the stencil never
+// needs edge checks. A new grid starts at the current turn, so it never
+// catches up on turns from before it existed
+void EpidemicSystem::resize(int mapWidth, int mapHeight) {
+    width = mapWidth;
+    height = mapHeight;
+    stride = width + 2;
+    steppedTurn = GameClock::now();
+    carrierCells = 0;
+    int cells = stride * (height + 2);
+
+    susceptible.assign(cells, 0.0f);
+    exposed.assign(cells, 0.0f);
+    infected.assign(cells, 0.0f);
+    recovered.assign(cells, 0.0f);
+    deaths.assign(cells, 0.0f);
+    pressure.assign(cells, 0.0f);
+    tradeLinks.clear();
+
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            susceptible[cellIndex(x, y)] = 1.0f;
+        }
+    }
+}
+
+int EpidemicSystem::cellIndex(int x, int y) const {
+    return (y + 1) * stride + (x + 1);
+}
+
+bool EpidemicSystem::inBounds(int x, int y) const {
+    return x >= 0 && x < width && y >= 0 && y < height;
+}
+
+void EpidemicSystem::seedOutbreak(int x, int y, float infectedShare) {
+    if (!inBounds(x, y)) {
+        return;
+    }
+    int cell = cellIndex(x, y);
+    bool wasCarrier = exposed[cell] + infected[cell] > EPIDEMIC_CARRIER_SHARE;
+    if (infectedShare > susceptible[cell]) infectedShare = susceptible[cell];
+    susceptible[cell] -= infectedShare;
+    infected[cell] += infectedShare;
+    if (!wasCarrier && exposed[cell] + infected[cell] > EPIDEMIC_CARRIER_SHARE) {
+        carrierCells++;
+    }
+}
+
+// Trading partners share travellers, and with them the plague
+void EpidemicSystem::addTradeLink(int x1, int y1, int x2, int y2, float weight) {
+    if (!inBounds(x1, y1) || !inBounds(x2, y2)) {
+        return;
+    }
+    int a = cellIndex(x1, y1);
+    int b = cellIndex(x2, y2);
+    for (size_t i = 0; i < tradeLinks.size(); i++) {
+        if ((tradeLinks[i].cellA == a && tradeLinks[i].cellB == b) ||
+            (tradeLinks[i].cellA == b && tradeLinks[i].cellB == a)) {
+            if (weight > tradeLinks[i].weight) tradeLinks[i].weight = weight;
+            return;
+        }
+    }
+    EpidemicLink link;
+    link.cellA = a;
+    link.cellB = b;
+    link.weight = weight;
+    tradeLinks.push_back(link);
+}
+
+void EpidemicSystem::clearTradeLinks() {
+    tradeLinks.clear();
+}
+
+// Infection pressure is the local infected share plus a fraction of the
+// infected share of the four neighbours
+void EpidemicSystem::computePressure(int firstRow, int lastRow) {
+    const float* inf = &infected[0];
+    float* out = &pressure[0];
+    const float spread = spreadRate;
+    for (int y = firstRow; y < lastRow; y++) {
+        int row = (y + 1) * stride + 1;
+        for (int x = 0; x < width; x++) {
+            int c = row + x;
+            float neighbours = inf[c - 1] + inf[c + 1] + inf[c - stride] + inf[c + stride];
+            out[c] = inf[c] + spread * neighbours;
+        }
+    }
+}
+
+// Returns how many cells of the band still carry the plague
+int EpidemicSystem::updateCells(int firstRow, int lastRow) {
+    float* s = &susceptible[0];
+    float* e = &exposed[0];
+    float* i = &infected[0];
+    float* r = &recovered[0];
+    float* d = &deaths[0];
+    const float* p = &pressure[0];
+    const float beta = transmissionRate;
+    const float sigma = incubationRate;
+    const float gamma = recoveryRate;
+    const float mu = mortalityRate;
+    int carriers = 0;
+    for (int y = firstRow; y < lastRow; y++) {
+        int row = (y + 1) * stride + 1;
+        for (int x = 0; x < width; x++) {
+            int c = row + x;
+            float newCases = beta * s[c] * p[c];
+            newCases = newCases < s[c] ? newCases : s[c];
+            float onset = sigma * e[c];
+            float recoveries = gamma * i[c];
+            float died = mu * i[c];
+            s[c] -= newCases;
+            e[c] += newCases - onset;
+            i[c] += onset - recoveries - died;
+            r[c] += recoveries;
+            d[c] = died;
+            carriers += e[c] + i[c] > EPIDEMIC_CARRIER_SHARE;
+        }
+    }
+    return carriers;
+}
+
+// Advances the plague by one turn
+void EpidemicSystem::step() {
+    TRACE_SCOPE("EpidemicSystem::step");
+    ALLOCATION_SCOPE(SUBSYSTEM_EPIDEMIC);
+    for (int band = 0; band < height; band += EPIDEMIC_TILE_ROWS) {
+        int last = band + EPIDEMIC_TILE_ROWS < height ? band + EPIDEMIC_TILE_ROWS : height;
+        computePressure(band, last);
+    }
+
+    for (size_t k = 0; k < tradeLinks.size(); k++) {
+        const EpidemicLink& link = tradeLinks[k];
+        pressure[link.cellA] += link.weight * infected[link.cellB];
+        pressure[link.cellB] += link.weight * infected[link.cellA];
+    }
+
+    carrierCells = 0;
+    for (int band = 0; band < height; band += EPIDEMIC_TILE_ROWS) {
+        int last = band + EPIDEMIC_TILE_ROWS < height ? band + EPIDEMIC_TILE_ROWS : height;
+        carrierCells += updateCells(band, last);
+    }
+}
+
+// Steps once for every turn the game clock has moved on since the last
+// call. Both the realm's turns and the multiplayer rounds come through
+// here, so the plague keeps one pace whichever of them moves time on
+void EpidemicSystem::stepTo(int turn) {
+    while (steppedTurn < turn) {
+        steppedTurn++;
+        if (!isActive()) {
+            steppedTurn = turn;
+            return;
+        }
+        step();
+    }
+}
+
+// The plague is over once almost nobody is carrying it. The carriers are
+// counted as each step updates the cells, so asking costs nothing
+bool EpidemicSystem::isActive() const {
+    return carrierCells > 0;
+}
+
+float EpidemicSystem::getInfected(int x, int y) const {
+    if (!inBounds(x, y)) {
+        return 0.0f;
+    }
+    return infected[cellIndex(x, y)];
+}
+
+// Share of the cell's people that died during the last step
+float EpidemicSystem::getDeathRate(int x, int y) const {
+    if (!inBounds(x, y)) {
+        return 0.0f;
+    }
+    return deaths[cellIndex(x, y)];
+}
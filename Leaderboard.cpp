@@ -0,0 +1,146 @@
+#include "MultiplayerSystems.h"
+
+static const char* RANKED_RESOURCE_NAMES[RANKED_RESOURCE_COUNT] = {
+    "Gold", "Food", "Army", "Materials", "Population", "Morale", "Happiness"
+};
+
+Leaderboard::Leaderboard() : root(-1) {
+}
+
+bool Leaderboard::ranksBefore(int a, int b) const {
+    if (nodes[a].value != nodes[b].value) return nodes[a].value > nodes[b].value;
+    return a < b;
+}
+
+void Leaderboard::resize(int node) {
+    nodes[node].size = 1 + sizeOf(nodes[node].left) + sizeOf(nodes[node].right);
+}
+
+// Joins two treaps where everything in left ranks before everything in right
+int Leaderboard::merge(int left, int right) {
+    if (left == -1) return right;
+    if (right == -1) return left;
+    if (nodes[left].priority > nodes[right].priority) {
+        nodes[left].right = merge(nodes[left].right, right);
+        resize(left);
+        return left;
+    }
+    nodes[right].left = merge(left, nodes[right].left);
+    resize(right);
+    return right;
+}
+
+// Splits into the kingdoms ranking before the given one and the rest
+void Leaderboard::split(int node, int kingdom, int& before, int& after) {
+    if (node == -1) {
+        before = after = -1;
+        return;
+    }
+    if (ranksBefore(node, kingdom)) {
+        split(nodes[node].right, kingdom, nodes[node].right, after);
+        before = node;
+    } else {
+        split(nodes[node].left, kingdom, before, nodes[node].left);
+        after = node;
+    }
+    resize(node);
+}
+
+int Leaderboard::erase(int node, int kingdom) {
+    if (node == kingdom) {
+        return merge(nodes[node].left, nodes[node].right);
+    }
+    if (ranksBefore(kingdom, node)) {
+        nodes[node].left = erase(nodes[node].left, kingdom);
+    } else {
+        nodes[node].right = erase(nodes[node].right, kingdom);
+    }
+    resize(node);
+    return node;
+}
+
+void Leaderboard::update(int kingdom, int value) {
+    if (kingdom < 0) return;
+    if (kingdom >= (int)nodes.size()) {
+        Node unranked = { 0, 0, -1, -1, 1, false };
+        nodes.resize(kingdom + 1, unranked);
+    }
+    Node& node = nodes[kingdom];
+    if (node.ranked && node.value == value) return;
+    if (node.ranked) {
+        root = erase(root, kingdom);
+    }
+    node.value = value;
+    // A fixed hash of the index keeps the tree shape the same between runs
+    node.priority = (unsigned int)(kingdom + 1) * 2654435761u;
+    node.left = node.right = -1;
+    node.size = 1;
+    node.ranked = true;
+
+    int before, after;
+    split(root, kingdom, before, after);
+    root = merge(merge(before, kingdom), after);
+}
+
+void Leaderboard::remove(int kingdom) {
+    if (kingdom < 0 || kingdom >= (int)nodes.size() || !nodes[kingdom].ranked) return;
+    root = erase(root, kingdom);
+    nodes[kingdom].ranked = false;
+}
+
+int Leaderboard::rankOf(int kingdom) const {
+    if (kingdom < 0 || kingdom >= (int)nodes.size() || !nodes[kingdom].ranked) return 0;
+    int rank = 1;
+    int node = root;
+    while (node != kingdom) {
+        if (ranksBefore(kingdom, node)) {
+            node = nodes[node].left;
+        } else {
+            rank += sizeOf(nodes[node].left) + 1;
+            node = nodes[node].right;
+        }
+    }
+    return rank + sizeOf(nodes[kingdom].left);
+}
+
+void Leaderboard::collect(int node, int limit, int* out, int& found) const {
+    if (node == -1 || found >= limit) return;
+    collect(nodes[node].left, limit, out, found);
+    if (found < limit) out[found++] = node;
+    collect(nodes[node].right, limit, out, found);
+}
+
+int Leaderboard::top(int k, int* out) const {
+    int found = 0;
+    collect(root, k, out, found);
+    return found;
+}
+
+void KingdomLeaderboards::update(int kingdom, const KingdomResources& resources) {
+    for (int r = 0; r < RANKED_RESOURCE_COUNT; r++) {
+        boards[r].update(kingdom, valueOf(r, resources));
+    }
+}
+
+void KingdomLeaderboards::remove(int kingdom) {
+    for (int r = 0; r < RANKED_RESOURCE_COUNT; r++) {
+        boards[r].remove(kingdom);
+    }
+}
+
+int KingdomLeaderboards::valueOf(int resource, const KingdomResources& resources) {
+    switch (resource) {
+        case RANK_GOLD: return resources.gold;
+        case RANK_FOOD: return resources.food;
+        case RANK_ARMY: return resources.army;
+        case RANK_MATERIALS: return resources.materials;
+        case RANK_POPULATION: return resources.population;
+        case RANK_MORALE: return resources.morale;
+        case RANK_HAPPINESS: return resources.happiness;
+        default: return 0;
+    }
+}
+
+const char* KingdomLeaderboards::resourceName(int resource) {
+    return resource >= 0 && resource < RANKED_RESOURCE_COUNT ? RANKED_RESOURCE_NAMES[resource] : "?";
+}
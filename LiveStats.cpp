@@ -0,0 +1,116 @@
+#include "MultiplayerSystems.h"
+#include <cstring>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define LIVE_STATS_POSIX 1
+#endif
+
+// Older glibc keeps shm_open in librt, so link with -lrt there
+
+// Tries to read a snapshot this many times before giving up on a writer
+// that keeps getting in the way
+const int LIVE_STATS_READ_ATTEMPTS = 1000;
+
+LiveStatsPublisher::LiveStatsPublisher() : segment(0) {
+}
+
+LiveStatsPublisher::~LiveStatsPublisher() {
+    close();
+}
+
+bool LiveStatsPublisher::open(const string& name) {
+    close();
+#ifdef LIVE_STATS_POSIX
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd == -1) {
+        cout << "Could not create live stats segment " << name << endl;
+        return false;
+    }
+    if (ftruncate(fd, sizeof(LiveStatsSegment)) == -1) {
+        ::close(fd);
+        cout << "Could not size live stats segment " << name << endl;
+        return false;
+    }
+    void* memory = mmap(0, sizeof(LiveStatsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        cout << "Could not map live stats segment " << name << endl;
+        return false;
+    }
+    segment = (LiveStatsSegment*)memory;
+    segmentName = name;
+    // A fresh segment is zero-filled, an old one may hold a half-written
+    // snapshot from a game that died mid-update
+    unsigned int sequence = segment->sequence.load(memory_order_relaxed);
+    if (sequence & 1) {
+        segment->sequence.store(sequence + 1, memory_order_release);
+    }
+    return true;
+#else
+    (void)name;
+    return false;
+#endif
+}
+
+// The segment is removed so dashboards stop showing a finished game
+void LiveStatsPublisher::close() {
+#ifdef LIVE_STATS_POSIX
+    if (segment != 0) {
+        munmap(segment, sizeof(LiveStatsSegment));
+        shm_unlink(segmentName.c_str());
+        segment = 0;
+    }
+#endif
+}
+
+// Odd sequence, write, even sequence. The fences keep the snapshot's
+// stores between the two sequence updates
+void LiveStatsPublisher::publish(const LiveStatsSnapshot& snapshot) {
+    if (segment == 0) {
+        return;
+    }
+    unsigned int sequence = segment->sequence.load(memory_order_relaxed);
+    segment->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&segment->data, &snapshot, sizeof(snapshot));
+    atomic_thread_fence(memory_order_release);
+    segment->sequence.store(sequence + 2, memory_order_release);
+}
+
+// For dashboards and sidecar tools. Returns false if nothing is published
+// under that name or no consistent copy could be taken
+bool LiveStatsPublisher::read(const string& name, LiveStatsSnapshot& snapshot) {
+#ifdef LIVE_STATS_POSIX
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd == -1) {
+        return false;
+    }
+    void* memory = mmap(0, sizeof(LiveStatsSegment), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        return false;
+    }
+    const LiveStatsSegment* shared = (const LiveStatsSegment*)memory;
+
+    bool consistent = false;
+    for (int attempt = 0; attempt < LIVE_STATS_READ_ATTEMPTS && !consistent; attempt++) {
+        unsigned int before = shared->sequence.load(memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        memcpy(&snapshot, (const void*)&shared->data, sizeof(snapshot));
+        atomic_thread_fence(memory_order_acquire);
+        unsigned int after = shared->sequence.load(memory_order_relaxed);
+        consistent = before == after && snapshot.magic == LIVE_STATS_MAGIC &&
+                     snapshot.version == LIVE_STATS_VERSION;
+    }
+    munmap(memory, sizeof(LiveStatsSegment));
+    return consistent;
+#else
+    (void)name;
+    (void)snapshot;
+    return false;
+#endif
+}
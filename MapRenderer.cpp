@@ -0,0 +1,78 @@
+#include "MultiplayerSystems.h"
+
+MapRenderer::MapRenderer(int width, int height) {
+    setViewSize(width, height);
+}
+
+void MapRenderer::setViewSize(int width, int height) {
+    viewWidth = width > 0 ? width : 1;
+    viewHeight = height > 0 ? height : 1;
+    cells.assign(viewWidth * viewHeight * 2, ' ');
+}
+
+// Builds the frame for the window at (viewX,viewY), moving the window back
+// inside the map if it hangs over an edge
+const string& MapRenderer::render(const MapSystem& map, int& viewX, int& viewY, bool showLegend) {
+    int width = viewWidth < map.getWidth() ? viewWidth : map.getWidth();
+    int height = viewHeight < map.getHeight() ? viewHeight : map.getHeight();
+    if (viewX > map.getWidth() - width) viewX = map.getWidth() - width;
+    if (viewY > map.getHeight() - height) viewY = map.getHeight() - height;
+    if (viewX < 0) viewX = 0;
+    if (viewY < 0) viewY = 0;
+
+    // Terrain, then the kingdoms in the window on top
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            char symbol = map.getTerrain(viewX + x, viewY + y).symbol;
+            cells[(y * width + x) * 2] = symbol;
+            cells[(y * width + x) * 2 + 1] = symbol;
+        }
+    }
+    map.getKingdomsInRect(viewX, viewY, viewX + width - 1, viewY + height - 1, visible);
+    for (size_t i = 0; i < visible.size(); i++) {
+        MapPosition pos = map.getPositionOf(visible[i]);
+        string name = map.getKingdomName(visible[i]);
+        int cell = ((pos.y - viewY) * width + (pos.x - viewX)) * 2;
+        cells[cell] = name.size() > 0 ? name[0] : '?';
+        cells[cell + 1] = name.size() > 1 ? name[1] : ' ';
+    }
+
+    string border = "+" + string(width * 5 - 1, '-') + "+\n";
+    frame.clear();
+    frame.reserve((width * 5 + 4) * (height + 4) + 128);
+    frame += "\nCurrent Map:";
+    if (width < map.getWidth() || height < map.getHeight()) {
+        frame += " (" + to_string(viewX) + "," + to_string(viewY) + ") to ("
+               + to_string(viewX + width - 1) + "," + to_string(viewY + height - 1) + ") of "
+               + to_string(map.getWidth()) + "x" + to_string(map.getHeight());
+    }
+    frame += "\n";
+    frame += border;
+    for (int y = 0; y < height; y++) {
+        frame += "| ";
+        for (int x = 0; x < width; x++) {
+            frame.append(&cells[(y * width + x) * 2], 2);
+            frame += " | ";
+        }
+        frame += "\n";
+    }
+    frame += border;
+
+    if (showLegend) {
+        frame += "\nLegend:\n";
+        for (size_t i = 0; i < visible.size(); i++) {
+            MapPosition pos = map.getPositionOf(visible[i]);
+            frame += map.getKingdomName(visible[i]) + " is in position (" + to_string(pos.x) + ","
+                   + to_string(pos.y) + "), holding " + to_string(map.getTerritorySize(visible[i]))
+                   + " tiles with a border of " + to_string(map.getBorderLength(visible[i])) + "\n";
+        }
+    }
+    return frame;
+}
+
+// One write and one flush for the whole map
+void MapRenderer::display(const MapSystem& map, int& viewX, int& viewY, bool showLegend) {
+    const string& text = render(map, viewX, viewY, showLegend);
+    cout.write(text.data(), text.size());
+    cout.flush();
+}
@@ -1,41 +1,146 @@
 #include "MultiplayerSystems.h"
 
-MapSystem::MapSystem() : kingdomCount(0) {
+// Saved games keep their changed chunks in these files, apart from the
+// chunk cache's own
+const char* const SAVE_CHUNK_PREFIX = "map_save_chunk_";
+
+MapSystem::MapSystem(int mapWidth, int mapHeight)
+    : kingdomCount(0), generator(1), tiles(mapWidth, mapHeight, TERRAIN_PLAINS), worldSeed(0) {
     mapLog.open("map_log.txt", ios::app);
+    paintDefaultTerrain();
+    regions.attach(&tiles);
+    territory.attach(&tiles, &seats);
+    paths.attach(&tiles);
+    resetRoutes();
+    vision.attach(&tiles, &seats, &territory);
 }
 
-void MapSystem::initializeKingdom(const string& kingdomName, int x, int y) {
+// Switches to a procedurally generated world. Nothing is generated here:
+// chunks are built the first time they are looked at, so this costs the
+// same for any map size
+void MapSystem::generateWorld(int mapWidth, int mapHeight, unsigned int seed) {
+    ALLOCATION_SCOPE(SUBSYSTEM_MAP);
+    if (seed == 0) seed = 1;
+    worldSeed = seed;
+    generator.setSeed(seed);
+    tiles.resize(mapWidth, mapHeight, TERRAIN_OCEAN);
+    tiles.setGenerator(&generator, "map_chunk_" + to_string(seed) + "_");
+    regions.attach(&tiles);  // The game fills population and military back in
+
+    for (int i = 0; i < kingdomCount; i++) {
+        tiles.setOwner(kingdomPositions[i].x, kingdomPositions[i].y, i);
+    }
+    territory.attach(&tiles, &seats);
+    territory.rebuildAll();
+    paths.attach(&tiles);
+    resetRoutes();
+    vision.attach(&tiles, &seats, &territory);
+
+    mapLog << "Generated a " << mapWidth << "x" << mapHeight << " world from seed " << seed << endl;
+    mapLog.flush();
+}
+
+// Open plains with defensible hills in the corners and a fertile valley
+// in the middle, the same bonuses the 4x4 map always had
+void MapSystem::paintDefaultTerrain() {
+    int right = tiles.getWidth() - 1;
+    int bottom = tiles.getHeight() - 1;
+    tiles.setTerrain(0, 0, TERRAIN_HILLS);
+    tiles.setTerrain(right, 0, TERRAIN_HILLS);
+    tiles.setTerrain(0, bottom, TERRAIN_HILLS);
+    tiles.setTerrain(right, bottom, TERRAIN_HILLS);
+    tiles.setTerrain(right / 2, bottom / 2, TERRAIN_RIVER_VALLEY);
+}
+
+// Routes are searched again from scratch after the map changes shape
+void MapSystem::resetRoutes() {
+    routes.attach(&paths);
+    for (int i = 0; i < kingdomCount; i++) {
+        routes.setSeat(i, kingdomPositions[i].x, kingdomPositions[i].y);
+    }
+}
+
+// Changes one tile and brings everything built on the terrain up to date
+void MapSystem::setTerrain(int x, int y, TerrainType terrain) {
+    if (!tiles.inBounds(x, y)) {
+        return;
+    }
+    int oldCost = getTerrain(x, y).moveCost;
+    tiles.setTerrain(x, y, terrain);
+    // A tile on a path can shift claims up to a claim radius past the
+    // seats that reach it
+    int reach = 2 * territory.getClaimRadius() + 1;
+    regions.invalidate(x, y);
+    territory.rebuildWithin(x, y, reach);
+    paths.invalidate();
+    routes.tileChanged(x, y, oldCost, TERRAIN_INFO[terrain].moveCost);
+    vision.markDirtyAround(x, y, reach);
+}
+
+// A kingdom is seen when its seat is
+bool MapSystem::canSeeKingdom(int viewer, int target) const {
+    if (target < 0 || target >= kingdomCount) {
+        return false;
+    }
+    return viewer == target || vision.canSee(viewer, kingdomPositions[target].x, kingdomPositions[target].y);
+}
+
+const TerrainInfo& MapSystem::getTerrain(int x, int y) const {
+    return TERRAIN_INFO[tiles.getTile(x, y).terrain];
+}
+
+// In bounds, on land a kingdom can live on, and not taken
+bool MapSystem::canSettle(int x, int y) const {
+    if (!tiles.inBounds(x, y)) {
+        return false;
+    }
+    MapTile tile = tiles.getTile(x, y);
+    return TERRAIN_INFO[tile.terrain].settleable && tile.owner == -1;
+}
+
+bool MapSystem::initializeKingdom(const string& kingdomName, int x, int y) {
+    ALLOCATION_SCOPE(SUBSYSTEM_MAP);
     if (kingdomCount >= MAX_KINGDOMS) {
         cout << "Maximum number of kingdoms reached!" << endl;
-        return;
+        return false;
     }
 
-    if (x < 0 || x >= MAP_SIZE || y < 0 || y >= MAP_SIZE) {
+    if (!tiles.inBounds(x, y)) {
         cout << "Invalid map coordinates!" << endl;
-        return;
+        return false;
     }
 
     // Check if position is already occupied
-    for (int i = 0; i < kingdomCount; i++) {
-        if (kingdomPositions[i].x == x && kingdomPositions[i].y == y) {
-            cout << "Position already occupied!" << endl;
-            return;
-        }
+    if (seats.occupantAt(x, y) != -1) {
+        cout << "Position already occupied!" << endl;
+        return false;
+    }
+
+    if (!getTerrain(x, y).settleable) {
+        cout << "Nobody can settle on " << getTerrain(x, y).name << "!" << endl;
+        return false;
     }
 
     kingdomNames[kingdomCount] = kingdomName;
     kingdomPositions[kingdomCount].x = x;
     kingdomPositions[kingdomCount].y = y;
+    tiles.setOwner(x, y, kingdomCount);
+    seats.insert(kingdomCount, x, y);
+    territory.rebuildAround(x, y);
+    routes.setSeat(kingdomCount, x, y);
+    vision.markDirtyAround(x, y, 2 * territory.getClaimRadius() + 1);
 
     // Log kingdom initialization
     mapLog << "Kingdom " << kingdomName << " initialized at position (" << x << "," << y << ")" << endl;
     mapLog.flush();
 
     kingdomCount++;
+    return true;
 }
 
 bool MapSystem::moveKingdom(const string& kingdomName, int newX, int newY) {
-    if (newX < 0 || newX >= MAP_SIZE || newY < 0 || newY >= MAP_SIZE) {
+    ALLOCATION_SCOPE(SUBSYSTEM_MAP);
+    if (!tiles.inBounds(newX, newY)) {
         cout << "Invalid map coordinates!" << endl;
         return false;
     }
@@ -55,11 +160,29 @@ bool MapSystem::moveKingdom(const string& kingdomName, int newX, int newY) {
     }
 
     // Check if new position is occupied
-    for (int i = 0; i < kingdomCount; i++) {
-        if (i != kingdomIndex && kingdomPositions[i].x == newX && kingdomPositions[i].y == newY) {
-            cout << "Position already occupied!" << endl;
-            return false;
-        }
+    int occupant = seats.occupantAt(newX, newY);
+    if (occupant != -1 && occupant != kingdomIndex) {
+        cout << "Position already occupied!" << endl;
+        return false;
+    }
+
+    if (!getTerrain(newX, newY).settleable) {
+        cout << "Nobody can settle on " << getTerrain(newX, newY).name << "!" << endl;
+        return false;
+    }
+
+    // The court has to travel there over land
+    vector<MapPosition> route;
+    int cost = paths.findPath(kingdomPositions[kingdomIndex].x, kingdomPositions[kingdomIndex].y,
+                              newX, newY, route);
+    if (cost < 0) {
+        cout << "There is no way over land to (" << newX << "," << newY << ")!" << endl;
+        return false;
+    }
+    if (cost > KINGDOM_MOVE_RANGE) {
+        cout << "(" << newX << "," << newY << ") is too far to move to (cost " << cost
+             << ", at most " << KINGDOM_MOVE_RANGE << ")!" << endl;
+        return false;
     }
 
     // Log the movement
@@ -67,40 +190,41 @@ bool MapSystem::moveKingdom(const string& kingdomName, int newX, int newY) {
            << kingdomPositions[kingdomIndex].y << ") to (" << newX << "," << newY << ")" << endl;
     mapLog.flush();
 
+    // The kingdom's people and soldiers move with its seat
+    int oldX = kingdomPositions[kingdomIndex].x;
+    int oldY = kingdomPositions[kingdomIndex].y;
+    for (int layer = REGION_POPULATION; layer < REGION_LAYER_COUNT; layer++) {
+        int value = regions.getValue((RegionLayer)layer, oldX, oldY);
+        regions.setValue((RegionLayer)layer, oldX, oldY, 0);
+        regions.setValue((RegionLayer)layer, newX, newY, value);
+    }
+
+    tiles.setOwner(oldX, oldY, -1);
     kingdomPositions[kingdomIndex].x = newX;
     kingdomPositions[kingdomIndex].y = newY;
+    tiles.setOwner(newX, newY, kingdomIndex);
+    seats.move(kingdomIndex, newX, newY);
+    territory.rebuildAround(oldX, oldY);
+    territory.rebuildAround(newX, newY);
+    routes.setSeat(kingdomIndex, newX, newY);
+    vision.markDirtyAround(oldX, oldY, 2 * territory.getClaimRadius() + 1);
+    vision.markDirtyAround(newX, newY, 2 * territory.getClaimRadius() + 1);
 
     return true;
 }
 
-void MapSystem::displayMap() {
-    cout << "\nCurrent Map:\n";
-    cout << "+-------------------+\n";
-    
-    for (int y = 0; y < MAP_SIZE; y++) {
-        cout << "| ";
-        for (int x = 0; x < MAP_SIZE; x++) {
-            bool kingdomFound = false;
-            for (int k = 0; k < kingdomCount; k++) {
-                if (kingdomPositions[k].x == x && kingdomPositions[k].y == y) {
-                    cout << kingdomNames[k].substr(0, 2) << " | ";
-                    kingdomFound = true;
-                    break;
-                }
-            }
-            if (!kingdomFound) {
-                cout << ".. | ";
-            }
-        }
-        cout << "\n";
-    }
-    
-    cout << "+-------------------+\n";
-    cout << "\nLegend:\n";
-    for (int i = 0; i < kingdomCount; i++) {
-        cout << kingdomNames[i] << " is in position (" 
-             << kingdomPositions[i].x << "," << kingdomPositions[i].y << ")\n";
-    }
+// Shows the window whose top-left tile is (viewX,viewY)
+void MapSystem::displayMap(int viewX, int viewY, bool showLegend) const {
+    ALLOCATION_SCOPE(SUBSYSTEM_MAP);
+    renderer.display(*this, viewX, viewY, showLegend);
+}
+
+// Shows the window centred on (x,y)
+void MapSystem::displayMapAround(int x, int y, bool showLegend) const {
+    ALLOCATION_SCOPE(SUBSYSTEM_MAP);
+    int viewX = x - renderer.getViewWidth() / 2;
+    int viewY = y - renderer.getViewHeight() / 2;
+    renderer.display(*this, viewX, viewY, showLegend);
 }
 
 MapPosition MapSystem::getKingdomPosition(const string& kingdomName) {
@@ -112,7 +236,76 @@ MapPosition MapSystem::getKingdomPosition(const string& kingdomName) {
     return {-1, -1}; // Return invalid position if kingdom not found
 }
 
+void MapSystem::getKingdomsWithin(int x, int y, int distance, vector<int>& found) const {
+    seats.findWithin(x, y, distance, found);
+}
+
+void MapSystem::getNearestKingdoms(int x, int y, int count, vector<int>& found) const {
+    seats.findNearest(x, y, count, found);
+}
+
+// Cheapest way over land between two tiles; returns its cost or -1
+int MapSystem::findRoute(int fromX, int fromY, int toX, int toY, vector<MapPosition>& route) const {
+    return paths.findPath(fromX, fromY, toX, toY, route);
+}
+
+// Turns an army needs to march between two seats, or -1 if it cannot
+int MapSystem::getMarchTurns(int fromIndex, int toIndex) const {
+    if (fromIndex < 0 || fromIndex >= kingdomCount || toIndex < 0 || toIndex >= kingdomCount) {
+        return -1;
+    }
+    vector<MapPosition> route;
+    int cost = paths.findPath(kingdomPositions[fromIndex].x, kingdomPositions[fromIndex].y,
+                              kingdomPositions[toIndex].x, kingdomPositions[toIndex].y, route);
+    if (cost < 0) {
+        return -1;
+    }
+    int turns = (cost + ARMY_MARCH_PER_TURN - 1) / ARMY_MARCH_PER_TURN;
+    return turns > 0 ? turns : 1;
+}
+
+void MapSystem::setRegionValue(RegionLayer layer, int x, int y, int value) {
+    regions.setValue(layer, x, y, value);
+}
+
+long long MapSystem::regionSum(RegionLayer layer, int x1, int y1, int x2, int y2) const {
+    return regions.sum(layer, x1, y1, x2, y2);
+}
+
+// Sum over the square of tiles within radius steps of (x,y) in each direction
+long long MapSystem::regionAround(RegionLayer layer, int x, int y, int radius) const {
+    return regions.sum(layer, x - radius, y - radius, x + radius, y + radius);
+}
+
+// Picks the free, settleable tile with the richest land around it, with
+// soldiers nearby counting against it. Large maps are sampled on a grid of
+// at most 16x16 candidates. Returns false when nothing can be settled
+bool MapSystem::suggestSite(int radius, MapPosition& site) const {
+    int stepX = tiles.getWidth() / 16 > 1 ? tiles.getWidth() / 16 : 1;
+    int stepY = tiles.getHeight() / 16 > 1 ? tiles.getHeight() / 16 : 1;
+    bool found = false;
+    long long bestScore = 0;
+    for (int y = stepY / 2; y < tiles.getHeight(); y += stepY) {
+        for (int x = stepX / 2; x < tiles.getWidth(); x += stepX) {
+            if (!canSettle(x, y)) {
+                continue;
+            }
+            long long score = regionAround(REGION_YIELD, x, y, radius) * 100
+                            - regionAround(REGION_MILITARY, x, y, radius);
+            if (!found || score > bestScore) {
+                found = true;
+                bestScore = score;
+                site.x = x;
+                site.y = y;
+            }
+        }
+    }
+    return found;
+}
+
 void MapSystem::saveMapToFile() const {
+    TRACE_SCOPE("MapSystem::saveMapToFile");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
     ofstream saveFile("map_save.txt");
     if (saveFile.is_open()) {
         saveFile << kingdomCount << endl;
@@ -121,19 +314,78 @@ void MapSystem::saveMapToFile() const {
             saveFile << kingdomPositions[i].x << endl;
             saveFile << kingdomPositions[i].y << endl;
         }
+
+        // Generated terrain is rebuilt from the seed; only changed chunks
+        // are kept, copied into the save's own chunk files
+        saveFile << tiles.getWidth() << endl;
+        saveFile << tiles.getHeight() << endl;
+        saveFile << worldSeed << endl;
+        if (worldSeed != 0) {
+            vector<int> savedChunks;
+            for (int i = 0; i < tiles.getChunkCount(); i++) {
+                if (tiles.hasChanges(i) && tiles.saveChunk(i, SAVE_CHUNK_PREFIX + to_string(i) + ".dat")) {
+                    savedChunks.push_back(i);
+                }
+            }
+            saveFile << savedChunks.size() << endl;
+            for (size_t i = 0; i < savedChunks.size(); i++) {
+                saveFile << savedChunks[i] << endl;
+            }
+        }
         saveFile.close();
     }
 }
 
 void MapSystem::loadMapFromFile() {
+    TRACE_SCOPE("MapSystem::loadMapFromFile");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
     ifstream loadFile("map_save.txt");
     if (loadFile.is_open()) {
+        for (int i = 0; i < kingdomCount; i++) {
+            tiles.setOwner(kingdomPositions[i].x, kingdomPositions[i].y, -1);
+        }
         loadFile >> kingdomCount;
+        seats.clear();
         for (int i = 0; i < kingdomCount; i++) {
             loadFile >> kingdomNames[i];
             loadFile >> kingdomPositions[i].x;
             loadFile >> kingdomPositions[i].y;
+            seats.insert(i, kingdomPositions[i].x, kingdomPositions[i].y);
+        }
+
+        // Older saves stop here and keep the current terrain
+        int mapWidth, mapHeight;
+        unsigned int seed;
+        if (loadFile >> mapWidth >> mapHeight >> seed) {
+            if (seed != 0) {
+                generateWorld(mapWidth, mapHeight, seed);
+                int savedChunks = 0;
+                loadFile >> savedChunks;
+                for (int i = 0; i < savedChunks; i++) {
+                    int index;
+                    loadFile >> index;
+                    // Older saves left their chunks in the cache's files
+                    if (!tiles.restoreChunk(index, SAVE_CHUNK_PREFIX + to_string(index) + ".dat")) {
+                        tiles.markChunkOnDisk(index);
+                    }
+                }
+            } else {
+                worldSeed = 0;
+                tiles.setGenerator(0, "map_chunk_");
+                tiles.resize(mapWidth, mapHeight, TERRAIN_PLAINS);
+                paintDefaultTerrain();
+                regions.attach(&tiles);
+            }
+        }
+
+        for (int i = 0; i < kingdomCount; i++) {
+            tiles.setOwner(kingdomPositions[i].x, kingdomPositions[i].y, i);
         }
+        territory.attach(&tiles, &seats);
+        territory.rebuildAll();
+        paths.attach(&tiles);
+        resetRoutes();
+        vision.attach(&tiles, &seats, &territory);
         loadFile.close();
     }
-} 
\ No newline at end of file
+}
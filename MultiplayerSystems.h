@@ -4,6 +4,10 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <atomic>
 #include "Stronghold.h"
 
 using std::string;
@@ -13,6 +17,8 @@ using std::endl;
 using std::ofstream;
 using std::ifstream;
 using std::ios;
+using std::vector;
+using std::pair;
 
 // Constants for the game
 const int MAX_KINGDOMS = 4;
@@ -20,6 +26,7 @@ const int MAX_MESSAGES = 100;
 const int MAX_ALLIANCES = 10;
 const int MAX_TRADES = 50;
 const int MAP_SIZE = 4;
+const int MAP_CHUNK_SIZE = 32;  // Tiles along one side of a map chunk
 
 // Message types
 enum MessageType {
@@ -44,6 +51,7 @@ struct Alliance {
     string kingdom2;
     int trustLevel;
     bool isActive;
+    int lastTouchedTurn;  // Turn the trust level was last brought up to date
 };
 
 // Trade structure
@@ -63,6 +71,470 @@ struct MapPosition {
     int y;
 };
 
+// Multiplayer kingdom data, kept by the game for every kingdom in play
+struct KingdomResources {
+    int gold;
+    int food;
+    int army;
+    int materials;  // For buildings and equipment
+    int population;
+    int morale;
+    int happiness;
+};
+
+struct KingdomData {
+    string name;
+    int x, y;
+    KingdomResources resources;
+    float plagueDeathCarry;  // Part of a citizen the plague has claimed so far
+};
+
+// Resources kingdoms are ranked by, one per KingdomResources field
+enum RankedResource {
+    RANK_GOLD,
+    RANK_FOOD,
+    RANK_ARMY,
+    RANK_MATERIALS,
+    RANK_POPULATION,
+    RANK_MORALE,
+    RANK_HAPPINESS,
+    RANKED_RESOURCE_COUNT
+};
+
+// Kingdoms ordered by one value, highest first, ties going to the lower
+// kingdom index. A treap whose nodes count their subtree, so changing a
+// value and asking for a kingdom's rank are O(log n) and the top k is
+// O(log n + k)
+class Leaderboard {
+private:
+    struct Node {
+        int value;
+        unsigned int priority;
+        int left;
+        int right;
+        int size;
+        bool ranked;
+    };
+    vector<Node> nodes;  // Indexed by kingdom
+    int root;
+
+    bool ranksBefore(int a, int b) const;
+    int sizeOf(int node) const { return node == -1 ? 0 : nodes[node].size; }
+    void resize(int node);
+    int merge(int left, int right);
+    void split(int node, int kingdom, int& before, int& after);
+    int erase(int node, int kingdom);
+    void collect(int node, int limit, int* out, int& found) const;
+
+public:
+    Leaderboard();
+    void update(int kingdom, int value);
+    void remove(int kingdom);
+    int rankOf(int kingdom) const;  // 1 for the highest, 0 if not ranked
+    int top(int k, int* out) const;  // Fills out with up to k kingdoms
+    int size() const { return sizeOf(root); }
+};
+
+// One leaderboard per resource, kept up to date as kingdoms change
+class KingdomLeaderboards {
+private:
+    Leaderboard boards[RANKED_RESOURCE_COUNT];
+
+public:
+    void update(int kingdom, const KingdomResources& resources);
+    void remove(int kingdom);
+    int rankOf(int resource, int kingdom) const { return boards[resource].rankOf(kingdom); }
+    int top(int resource, int k, int* out) const { return boards[resource].top(k, out); }
+    static int valueOf(int resource, const KingdomResources& resources);
+    static const char* resourceName(int resource);
+};
+
+// Each resource summed over every kingdom. A change only marks the sums
+// dirty; they are added up again the next time one is asked for
+class WorldTotals {
+private:
+    const KingdomData* kingdoms;
+    const int* kingdomCount;
+    long long totals[RANKED_RESOURCE_COUNT];
+    bool dirty;
+
+public:
+    WorldTotals(const KingdomData* kingdomList, const int* count);
+    void markDirty() { dirty = true; }
+    long long get(int resource);
+};
+
+// Kinds of land a map tile can be
+enum TerrainType {
+    TERRAIN_OCEAN,
+    TERRAIN_PLAINS,
+    TERRAIN_FOREST,
+    TERRAIN_HILLS,
+    TERRAIN_MOUNTAINS,
+    TERRAIN_RIVER_VALLEY,
+    TERRAIN_TYPE_COUNT
+};
+
+// Fixed properties of each terrain type
+struct TerrainInfo {
+    const char* name;
+    char symbol;
+    int yield;            // Resources gathered per turn
+    int populationBonus;  // Extra starting citizens for a kingdom seated here
+    int defenseBonus;     // Extra starting morale for a kingdom seated here
+    bool settleable;
+    int moveCost;         // Turns to cross, 0 if impassable
+};
+
+extern const TerrainInfo TERRAIN_INFO[TERRAIN_TYPE_COUNT];
+
+// One map tile, kept small so chunks stay compact
+struct MapTile {
+    unsigned char terrain;
+    unsigned char yield;
+    short owner;  // Kingdom index, -1 when unclaimed
+};
+
+struct MapChunk {
+    MapTile tiles[MAP_CHUNK_SIZE * MAP_CHUNK_SIZE];
+};
+
+// Deterministic terrain from a world seed. Any tile can be generated on
+// its own, so chunks can be built in any order and rebuilt after eviction
+class TerrainGenerator {
+private:
+    unsigned int seed;
+
+    float latticeValue(int x, int y, unsigned int salt) const;
+    float smoothNoise(float x, float y, unsigned int salt) const;
+    float fractalNoise(int x, int y, int scale, unsigned int salt) const;
+
+public:
+    TerrainGenerator(unsigned int worldSeed = 1);
+    void setSeed(unsigned int worldSeed) { seed = worldSeed; }
+    unsigned int getSeed() const { return seed; }
+    MapTile generateTile(int x, int y) const;
+    void fillChunk(int chunkX, int chunkY, MapChunk& chunk) const;
+};
+
+// Tile storage split into fixed-size chunks reached through a chunk table.
+// A missing chunk is generated (or read back from disk) the first time one
+// of its tiles is touched. When too many chunks are in memory the least
+// recently used one is dropped, after writing it to disk if it changed.
+// Saved games copy changed chunks into files of their own, so eviction
+// never writes into a save. Without a generator untouched chunks read as
+// the fill terrain
+class TileMap {
+private:
+    int width;
+    int height;
+    int chunksX;
+    int chunksY;
+    MapTile defaultTile;
+    const TerrainGenerator* generator;
+    int residentLimit;
+    string chunkFilePrefix;
+
+    // Chunk cache; filled in lazily, even by const readers
+    mutable vector<MapChunk*> chunkTable;
+    mutable vector<int> chunkLastUsed;
+    mutable vector<unsigned char> chunkFlags;
+    mutable vector<int> residentChunks;
+    mutable int useClock;
+
+    int chunkIndex(int x, int y) const;
+    MapChunk* residentChunk(int index, bool create) const;
+    void evictChunk(int index) const;
+    void evictColdChunks(int keepIndex) const;
+    string chunkFileName(int index) const;
+    TileMap(const TileMap&);
+    TileMap& operator=(const TileMap&);
+
+public:
+    TileMap(int mapWidth, int mapHeight, TerrainType fill);
+    ~TileMap();
+    void resize(int mapWidth, int mapHeight, TerrainType fill);
+    void clear();
+    void setGenerator(const TerrainGenerator* terrainGenerator, const string& filePrefix);
+    void setResidentLimit(int chunks);
+    bool hasChanges(int index) const;
+    bool saveChunk(int index, const string& fileName) const;
+    bool restoreChunk(int index, const string& fileName);
+    void markChunkOnDisk(int index);
+    bool inBounds(int x, int y) const;
+    MapTile getTile(int x, int y) const;
+    void setTerrain(int x, int y, TerrainType terrain);
+    void setOwner(int x, int y, int owner);
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getChunkCount() const { return chunksX * chunksY; }
+    int getAllocatedChunks() const { return (int)residentChunks.size(); }
+};
+
+// Uniform grid of buckets over kingdom seats. Only buckets that hold a
+// kingdom exist, so huge empty maps cost nothing. Distances are Manhattan
+// distances, like everywhere else on the map
+class SpatialIndex {
+private:
+    int bucketSize;
+    std::unordered_map<long long, vector<int> > buckets;
+    vector<MapPosition> positions;  // By id; x is -1 when the id is not stored
+    int entryCount;
+
+    long long bucketKey(int bucketX, int bucketY) const;
+    void scanBucket(int bucketX, int bucketY, int x, int y, int distance, vector<int>& found) const;
+
+public:
+    SpatialIndex(int cellSize = 16);
+    void clear();
+    void insert(int id, int x, int y);
+    void remove(int id);
+    void move(int id, int newX, int newY);
+    int occupantAt(int x, int y) const;
+    void findWithin(int x, int y, int distance, vector<int>& found) const;
+    void findNearest(int x, int y, int count, vector<int>& found) const;
+    void findInRect(int x1, int y1, int x2, int y2, vector<int>& found) const;
+    int size() const { return entryCount; }
+    int getIdLimit() const { return (int)positions.size(); }
+    MapPosition getPosition(int id) const;
+};
+
+// Per-tile layers that regions are scored on
+enum RegionLayer {
+    REGION_YIELD,       // Read from the tiles themselves
+    REGION_POPULATION,  // Set by the game, usually at kingdom seats
+    REGION_MILITARY,
+    REGION_LAYER_COUNT
+};
+
+// A chunk's hand-set layer values and its summed-area tables, one entry
+// wider than the chunk so the first row and column are zero
+struct RegionChunk {
+    int values[REGION_LAYER_COUNT - 1][MAP_CHUNK_SIZE * MAP_CHUNK_SIZE];
+    int sums[REGION_LAYER_COUNT][(MAP_CHUNK_SIZE + 1) * (MAP_CHUNK_SIZE + 1)];
+    bool dirty;
+};
+
+// Summed-area tables kept per map chunk. A rectangle inside one chunk is
+// four lookups, a larger one is four lookups per chunk it covers. Changes
+// only mark their chunk dirty and the table is rebuilt on the next query
+class RegionSums {
+private:
+    const TileMap* tiles;
+    int chunksX;
+    int chunksY;
+    mutable vector<RegionChunk*> chunkTable;
+
+    RegionChunk* chunkAt(int chunkX, int chunkY) const;
+    void rebuild(int chunkX, int chunkY, RegionChunk& chunk) const;
+    RegionSums(const RegionSums&);
+    RegionSums& operator=(const RegionSums&);
+
+public:
+    RegionSums();
+    ~RegionSums();
+    void attach(const TileMap* map);
+    void clear();
+    void invalidate(int x, int y);
+    void setValue(RegionLayer layer, int x, int y, int value);
+    int getValue(RegionLayer layer, int x, int y) const;
+    long long sum(RegionLayer layer, int x1, int y1, int x2, int y2) const;
+};
+
+// Owner and step distance to the owner's seat for every tile of a chunk
+struct TerritoryChunk {
+    short owners[MAP_CHUNK_SIZE * MAP_CHUNK_SIZE];
+    unsigned char distances[MAP_CHUNK_SIZE * MAP_CHUNK_SIZE];
+};
+
+// Each land tile belongs to the closest seat within claimRadius steps,
+// found by a breadth-first search from all seats at once; ties go to the
+// lower kingdom index. A change only redoes the tiles around the seat
+// involved, and border lengths and neighbours are recounted lazily for
+// the kingdoms near it
+class TerritoryMap {
+private:
+    const TileMap* tiles;
+    const SpatialIndex* seats;
+    int claimRadius;
+    int chunksX;
+    int chunksY;
+    vector<TerritoryChunk*> chunkTable;
+    int territorySize[MAX_KINGDOMS];
+
+    mutable int borderLength[MAX_KINGDOMS];
+    mutable bool adjacent[MAX_KINGDOMS][MAX_KINGDOMS];
+    mutable bool statsDirty[MAX_KINGDOMS];
+
+    // Search window reused by every rebuild
+    vector<short> scratchOwners;
+    vector<unsigned char> scratchDistances;
+    vector<int> frontier;
+
+    bool claimable(int x, int y) const;
+    void setClaim(int x, int y, int owner, int distance);
+    void refreshStats(int kingdom) const;
+    TerritoryMap(const TerritoryMap&);
+    TerritoryMap& operator=(const TerritoryMap&);
+
+public:
+    TerritoryMap(int radius = 6);
+    ~TerritoryMap();
+    void attach(const TileMap* map, const SpatialIndex* seatIndex);
+    void clear();
+    void rebuildAround(int x, int y);
+    void rebuildWithin(int x, int y, int extent);
+    void rebuildAll();
+    int getOwner(int x, int y) const;
+    int getDistance(int x, int y) const;
+    bool isBorder(int x, int y) const;
+    int getSize(int kingdom) const;
+    int getBorderLength(int kingdom) const;
+    bool areNeighbours(int kingdomA, int kingdomB) const;
+    int getClaimRadius() const { return claimRadius; }
+};
+
+// Sight of an army around its seat, before the size bonus
+const int BASE_SIGHT_RADIUS = 2;
+const int MAX_SIGHT_RADIUS = 8;
+
+// Bit x of rows[y] is set when tile (x,y) of the chunk can be seen
+struct VisionChunk {
+    unsigned int rows[MAP_CHUNK_SIZE];
+    bool listed;  // Already in the kingdom's list of chunks to clear
+};
+
+// Fog of war. What each kingdom sees is a bitset per chunk covering its
+// territory and everything within its army's sight of the seat. Chunk rows
+// are one word wide, so whole runs of tiles are set with a single mask.
+// Kingdoms are only redrawn when something near them changed
+class VisibilityMap {
+private:
+    const TileMap* tiles;
+    const SpatialIndex* seats;
+    const TerritoryMap* territory;
+    int chunksX;
+    int chunksY;
+    vector<VisionChunk*> chunkTable[MAX_KINGDOMS];
+    vector<int> touchedChunks[MAX_KINGDOMS];
+    int sightRadius[MAX_KINGDOMS];
+    bool dirty[MAX_KINGDOMS];
+
+    void markSpan(int kingdom, int y, int x1, int x2);
+    void refresh(int kingdom);
+    VisibilityMap(const VisibilityMap&);
+    VisibilityMap& operator=(const VisibilityMap&);
+
+public:
+    VisibilityMap();
+    ~VisibilityMap();
+    void attach(const TileMap* map, const SpatialIndex* seatIndex, const TerritoryMap* claims);
+    void clear();
+    void setSightRadius(int kingdom, int radius);
+    void markDirtyAround(int x, int y, int distance);
+    bool canSee(int kingdom, int x, int y);
+    int countVisible(int kingdom);
+};
+
+// Movement cost of each terrain spent by an army in one turn of marching
+const int ARMY_MARCH_PER_TURN = 4;
+// Most movement cost a kingdom may spend moving its seat in one go
+const int KINGDOM_MOVE_RANGE = 12;
+// Flow fields cover this many tiles around their target in each direction
+const int FLOW_FIELD_RANGE = 64;
+
+// Cheapest cost from every tile near a target to the target itself, shared
+// by any number of armies heading the same way. Costs are -1 where the
+// target cannot be reached
+struct FlowField {
+    int targetX;
+    int targetY;
+    int originX;
+    int originY;
+    int width;
+    int height;
+    int revision;
+    vector<int> costs;
+
+    int costAt(int x, int y) const;
+};
+
+struct PathNode {
+    int x;
+    int y;
+    int cost;     // Spent from the start
+    int parent;
+    bool closed;
+};
+
+// Terrain-aware routes. Entering a tile costs its terrain's moveCost and
+// the sea cannot be crossed. Single routes use A*; armies converging on one
+// target share a flow field. All search memory is kept between calls
+class PathFinder {
+private:
+    const TileMap* tiles;
+    int searchLimit;
+    int revision;
+
+    // Scratch arena: nodes, the open heap and a tile-to-node hash table
+    vector<PathNode> nodes;
+    vector<pair<int, int> > openHeap;
+    vector<long long> slotKeys;
+    vector<int> slotNodes;
+    vector<unsigned int> slotStamps;
+    unsigned int stamp;
+
+    vector<FlowField> flowFields;
+    vector<int> flowFieldUsed;
+    int flowClock;
+
+    int stepCost(int x, int y) const;
+    int findNode(int x, int y) const;
+    int addNode(int x, int y, int cost, int parent);
+    void growSlots();
+    void buildFlowField(FlowField& field);
+
+public:
+    PathFinder(int maxExpanded = 20000);
+    void attach(const TileMap* map);
+    void invalidate();
+    int getRevision() const { return revision; }
+    int findPath(int fromX, int fromY, int toX, int toY, vector<MapPosition>& path);
+    const FlowField& getFlowField(int targetX, int targetY);
+};
+
+// Cheapest land route between every pair of kingdom seats. Routes are
+// searched only when asked for and kept until something they depend on
+// changes: a seat moving, a tile on the route getting dearer, or a tile
+// getting cheaper close enough to offer a shortcut. Caravans pay the same
+// cost in both directions
+class RouteCache {
+private:
+    PathFinder* paths;
+    MapPosition seatPositions[MAX_KINGDOMS];
+    int costs[MAX_KINGDOMS][MAX_KINGDOMS];
+    bool stale[MAX_KINGDOMS][MAX_KINGDOMS];
+    vector<MapPosition> routes[MAX_KINGDOMS][MAX_KINGDOMS];  // Only [low][high] is used
+    int searches;
+
+public:
+    RouteCache();
+    void attach(PathFinder* finder);
+    void clear();
+    void setSeat(int kingdom, int x, int y);
+    void tileChanged(int x, int y, int oldCost, int newCost);
+    int getCost(int kingdomA, int kingdomB);
+    const vector<MapPosition>& getRoute(int kingdomA, int kingdomB);
+    int getSearchCount() const { return searches; }
+};
+
+// Extra infection pressure between two trading cities
+struct EpidemicLink {
+    int cellA;
+    int cellB;
+    float weight;
+};
+
 // Communication System
 class CommunicationSystem {
 private:
@@ -85,6 +557,8 @@ private:
     int allianceCount;
     ofstream allianceLog;
 
+    int driftedTrust(const Alliance& alliance, int& turnsUsed) const;
+
 public:
     AllianceSystem();
     bool formAlliance(const string& kingdom1, const string& kingdom2);
@@ -109,11 +583,37 @@ public:
                    const string& resource1Type, int resource1Amount,
                    const string& resource2Type, int resource2Amount);
     bool acceptTrade(int tradeId);
-    void executeSmuggling(const string& kingdom, int goldAmount, int riskPercentage);
+    int executeSmuggling(const string& kingdom, int goldAmount, int riskPercentage, int routeCost = 0);
     void saveTradesToFile() const;
     void loadTradesFromFile();
 };
 
+// Largest part of the map drawn at once
+const int MAP_VIEW_WIDTH = 16;
+const int MAP_VIEW_HEIGHT = 12;
+
+class MapSystem;
+
+// Draws a window of the map into a text frame: terrain first, then the
+// kingdoms inside the window stamped on top, then the whole frame is
+// written out at once. The cost depends on the window, not the map
+class MapRenderer {
+private:
+    int viewWidth;
+    int viewHeight;
+    vector<char> cells;  // Two characters per tile of the window
+    vector<int> visible;
+    string frame;
+
+public:
+    MapRenderer(int width = MAP_VIEW_WIDTH, int height = MAP_VIEW_HEIGHT);
+    void setViewSize(int width, int height);
+    int getViewWidth() const { return viewWidth; }
+    int getViewHeight() const { return viewHeight; }
+    const string& render(const MapSystem& map, int& viewX, int& viewY, bool showLegend);
+    void display(const MapSystem& map, int& viewX, int& viewY, bool showLegend);
+};
+
 // Map System
 class MapSystem {
 private:
@@ -121,15 +621,62 @@ private:
     string kingdomNames[MAX_KINGDOMS];
     int kingdomCount;
     ofstream mapLog;
+    TerrainGenerator generator;
+    TileMap tiles;
+    unsigned int worldSeed;  // 0 for the classic hand-made map
+    SpatialIndex seats;
+    RegionSums regions;
+    TerritoryMap territory;
+    mutable PathFinder paths;
+    mutable RouteCache routes;
+    mutable MapRenderer renderer;
+    mutable VisibilityMap vision;
+
+    void paintDefaultTerrain();
+    void resetRoutes();
 
 public:
-    MapSystem();
-    void initializeKingdom(const string& kingdomName, int x, int y);
+    MapSystem(int mapWidth = MAP_SIZE, int mapHeight = MAP_SIZE);
+    void generateWorld(int mapWidth, int mapHeight, unsigned int seed);
+    bool canSettle(int x, int y) const;
+    bool initializeKingdom(const string& kingdomName, int x, int y);
     bool moveKingdom(const string& kingdomName, int newX, int newY);
-    void displayMap();
+    void displayMap(int viewX = 0, int viewY = 0, bool showLegend = true) const;
+    void displayMapAround(int x, int y, bool showLegend = true) const;
     void saveMapToFile() const;
     void loadMapFromFile();
     MapPosition getKingdomPosition(const string& kingdomName);
+    int getWidth() const { return tiles.getWidth(); }
+    int getHeight() const { return tiles.getHeight(); }
+    MapTile getTile(int x, int y) const { return tiles.getTile(x, y); }
+    const TerrainInfo& getTerrain(int x, int y) const;
+    int getKingdomCount() const { return kingdomCount; }
+    string getKingdomName(int index) const { return kingdomNames[index]; }
+    MapPosition getPositionOf(int index) const { return kingdomPositions[index]; }
+    bool isOccupied(int x, int y) const { return seats.occupantAt(x, y) != -1; }
+    int getKingdomAt(int x, int y) const { return seats.occupantAt(x, y); }
+    void getKingdomsWithin(int x, int y, int distance, vector<int>& found) const;
+    void getNearestKingdoms(int x, int y, int count, vector<int>& found) const;
+    void getKingdomsInRect(int x1, int y1, int x2, int y2, vector<int>& found) const { seats.findInRect(x1, y1, x2, y2, found); }
+    void setRegionValue(RegionLayer layer, int x, int y, int value);
+    long long regionSum(RegionLayer layer, int x1, int y1, int x2, int y2) const;
+    long long regionAround(RegionLayer layer, int x, int y, int radius) const;
+    bool suggestSite(int radius, MapPosition& site) const;
+    int getTerritoryOwner(int x, int y) const { return territory.getOwner(x, y); }
+    bool isTerritoryBorder(int x, int y) const { return territory.isBorder(x, y); }
+    int getTerritorySize(int index) const { return territory.getSize(index); }
+    int getBorderLength(int index) const { return territory.getBorderLength(index); }
+    int getClaimRadius() const { return territory.getClaimRadius(); }
+    bool areNeighbours(int indexA, int indexB) const { return territory.areNeighbours(indexA, indexB); }
+    int findRoute(int fromX, int fromY, int toX, int toY, vector<MapPosition>& route) const;
+    int getMarchTurns(int fromIndex, int toIndex) const;
+    const FlowField& getFlowField(int targetX, int targetY) const { return paths.getFlowField(targetX, targetY); }
+    int getRouteCost(int indexA, int indexB) const { return routes.getCost(indexA, indexB); }
+    void setTerrain(int x, int y, TerrainType terrain);
+    void setSightRadius(int index, int radius) { vision.setSightRadius(index, radius); }
+    bool canSee(int viewer, int x, int y) const { return vision.canSee(viewer, x, y); }
+    bool canSeeKingdom(int viewer, int target) const;
+    int countVisibleTiles(int viewer) const { return vision.countVisible(viewer); }
 };
 
 // War System
@@ -140,19 +687,127 @@ private:
     string kingdomNames[MAX_KINGDOMS];
     int kingdomCount;
     
-    int calculateBattleOutcome(const Army& attacker, const Army& defender);
+    int calculateBattleOutcome(const Army& attacker, const Army& defender, int marchTurns);
     void applyBattleConsequences(Army& winner, Army& loser, ResourceManager& winnerRes, ResourceManager& loserRes);
     int getKingdomIndex(const string& kingdomName);
 
 public:
     WarSystem();
-    void declareWar(const string& attacker, const string& defender, Army& attackerArmy);
+    void declareWar(const string& attacker, const string& defender, Army& attackerArmy, int marchTurns = 0);
     void simulateBattle(const string& attacker, const string& defender,
-                       ResourceManager& attackerRes, ResourceManager& defenderRes);
+                       ResourceManager& attackerRes, ResourceManager& defenderRes, int marchTurns = 0);
     void saveWarLogToFile() const;
     void loadWarLogFromFile();
     void registerKingdom(const string& kingdomName, const Army& initialArmy);
+    bool isRegistered(const string& kingdomName) { return getKingdomIndex(kingdomName) != -1; }
     Army& getKingdomArmy(const string& kingdomName);
 };
 
+// Epidemic System
+// SEIR plague model over the map grid. Each cell holds the share of its
+// people that are susceptible, exposed, infected or recovered. Infection
+// spreads to neighbouring cells through a 5-point stencil and between
+// trading cities through explicit links
+class EpidemicSystem {
+private:
+    int width;
+    int height;
+    int stride;  // Row length including the zero border
+    int steppedTurn;  // Game turn the plague was last brought up to
+    int carrierCells;  // Cells still carrying the plague
+    vector<float> susceptible;
+    vector<float> exposed;
+    vector<float> infected;
+    vector<float> recovered;
+    vector<float> deaths;
+    vector<float> pressure;
+    vector<EpidemicLink> tradeLinks;
+
+    float transmissionRate;
+    float incubationRate;
+    float recoveryRate;
+    float mortalityRate;
+    float spreadRate;
+
+    int cellIndex(int x, int y) const;
+    bool inBounds(int x, int y) const;
+    void computePressure(int firstRow, int lastRow);
+    int updateCells(int firstRow, int lastRow);
+
+public:
+    EpidemicSystem(int mapWidth = MAP_SIZE, int mapHeight = MAP_SIZE);
+    void resize(int mapWidth, int mapHeight);
+    void seedOutbreak(int x, int y, float infectedShare);
+    void addTradeLink(int x1, int y1, int x2, int y2, float weight);
+    void clearTradeLinks();
+    void step();
+    void stepTo(int turn);
+    bool isActive() const;
+    float getInfected(int x, int y) const;
+    float getDeathRate(int x, int y) const;
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
+
+// Name of the shared-memory segment the live stats are published in
+const char* const LIVE_STATS_NAME = "/stronghold_live_stats";
+const int LIVE_STATS_MAGIC = 0x53484C53;  // "SHLS"
+const int LIVE_STATS_VERSION = 1;
+const int LIVE_STATS_NAME_LENGTH = 32;
+
+struct LiveKingdomStats {
+    char name[LIVE_STATS_NAME_LENGTH];
+    int x;
+    int y;
+    int gold;
+    int army;
+    int population;
+    int happiness;
+    int morale;
+    int allies;
+    int wars;
+};
+
+// Everything a dashboard sees, all fixed-size so it can sit in shared memory
+struct LiveStatsSnapshot {
+    int magic;
+    int version;
+    int turn;
+    int kingdomCount;
+    int activeKingdom;
+    int allianceCount;  // Allied pairs
+    int warCount;       // Pairs at war
+    LiveKingdomStats kingdoms[MAX_KINGDOMS];
+};
+
+// The shared layout: an even sequence number means the snapshot after it
+// is complete, an odd one that the game is in the middle of writing it
+struct LiveStatsSegment {
+    atomic<unsigned int> sequence;
+    unsigned int reserved;
+    LiveStatsSnapshot data;
+};
+
+// Publishes a summary of the running game into a POSIX shared-memory
+// segment guarded by a seqlock. The game never waits for readers; a
+// reader copies the snapshot and retries if the sequence moved while it
+// was copying. On systems without POSIX shared memory open() fails and
+// nothing is published
+class LiveStatsPublisher {
+private:
+    LiveStatsSegment* segment;
+    string segmentName;
+    LiveStatsPublisher(const LiveStatsPublisher&);
+    LiveStatsPublisher& operator=(const LiveStatsPublisher&);
+
+public:
+    LiveStatsPublisher();
+    ~LiveStatsPublisher();
+    bool open(const string& name);
+    void close();
+    bool isOpen() const { return segment != 0; }
+    void publish(const LiveStatsSnapshot& snapshot);
+    static bool read(const string& name, LiveStatsSnapshot& snapshot);
+};
+
 #endif // MULTIPLAYER_SYSTEMS_H 
\ No newline at end of file
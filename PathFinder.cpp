@@ -0,0 +1,254 @@
+#include "MultiplayerSystems.h"
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+
+// Flow fields kept around for reuse, most recently used first to survive
+const int FLOW_FIELD_CACHE = 8;
+
+// The four neighbouring tiles
+const int STEP_X[4] = { 1, -1, 0, 0 };
+const int STEP_Y[4] = { 0, 0, 1, -1 };
+
+int FlowField::costAt(int x, int y) const {
+    int localX = x - originX;
+    int localY = y - originY;
+    if (localX < 0 || localY < 0 || localX >= width || localY >= height) {
+        return -1;
+    }
+    return costs[localY * width + localX];
+}
+
+PathFinder::PathFinder(int maxExpanded)
+    : tiles(0), searchLimit(maxExpanded), revision(0), stamp(0), flowClock(0) {
+}
+
+void PathFinder::attach(const TileMap* map) {
+    tiles = map;
+    invalidate();
+}
+
+// Call when terrain changes; cached flow fields are rebuilt on next use
+void PathFinder::invalidate() {
+    revision++;
+}
+
+// 0 where the tile cannot be entered
+int PathFinder::stepCost(int x, int y) const {
+    if (!tiles->inBounds(x, y)) {
+        return 0;
+    }
+    return TERRAIN_INFO[tiles->getTile(x, y).terrain].moveCost;
+}
+
+// Open addressing over (x,y) keys. Slots from earlier searches are ignored
+// by their stamp, so nothing has to be cleared between searches
+int PathFinder::findNode(int x, int y) const {
+    long long key = ((long long)y << 32) | (unsigned int)x;
+    size_t mask = slotKeys.size() - 1;
+    size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 20) & mask;
+    while (slotStamps[slot] == stamp) {
+        if (slotKeys[slot] == key) {
+            return slotNodes[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    return -1;
+}
+
+int PathFinder::addNode(int x, int y, int cost, int parent) {
+    if ((nodes.size() + 1) * 2 > slotKeys.size()) {
+        growSlots();
+    }
+    PathNode node;
+    node.x = x;
+    node.y = y;
+    node.cost = cost;
+    node.parent = parent;
+    node.closed = false;
+    nodes.push_back(node);
+
+    long long key = ((long long)y << 32) | (unsigned int)x;
+    size_t mask = slotKeys.size() - 1;
+    size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 20) & mask;
+    while (slotStamps[slot] == stamp) {
+        slot = (slot + 1) & mask;
+    }
+    slotKeys[slot] = key;
+    slotNodes[slot] = (int)nodes.size() - 1;
+    slotStamps[slot] = stamp;
+    return (int)nodes.size() - 1;
+}
+
+// Doubles the hash table and puts this search's nodes back in
+void PathFinder::growSlots() {
+    size_t capacity = slotKeys.empty() ? 1024 : slotKeys.size() * 2;
+    slotKeys.assign(capacity, 0);
+    slotNodes.assign(capacity, -1);
+    slotStamps.assign(capacity, 0);
+    stamp = 1;
+    size_t mask = capacity - 1;
+    for (size_t i = 0; i < nodes.size(); i++) {
+        long long key = ((long long)nodes[i].y << 32) | (unsigned int)nodes[i].x;
+        size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 20) & mask;
+        while (slotStamps[slot] == stamp) {
+            slot = (slot + 1) & mask;
+        }
+        slotKeys[slot] = key;
+        slotNodes[slot] = (int)i;
+        slotStamps[slot] = stamp;
+    }
+}
+
+// A* with a Manhattan-distance estimate; every step costs at least 1, so
+// the estimate never overshoots. Fills path from start to target and
+// returns its cost, or -1 when there is no way through within the search
+// limit
+int PathFinder::findPath(int fromX, int fromY, int toX, int toY, vector<MapPosition>& path) {
+    path.clear();
+    if (!tiles || !tiles->inBounds(fromX, fromY) || stepCost(toX, toY) == 0) {
+        return -1;
+    }
+
+    nodes.clear();
+    openHeap.clear();
+    if (slotKeys.empty()) {
+        growSlots();
+    }
+    stamp++;
+    if (stamp == 0) {
+        slotStamps.assign(slotStamps.size(), 0);
+        stamp = 1;
+    }
+
+    std::greater<pair<int, int> > later;
+    int start = addNode(fromX, fromY, 0, -1);
+    openHeap.push_back(make_pair(abs(toX - fromX) + abs(toY - fromY), start));
+    int expanded = 0;
+    int goal = -1;
+
+    while (!openHeap.empty() && expanded < searchLimit) {
+        pop_heap(openHeap.begin(), openHeap.end(), later);
+        int current = openHeap.back().second;
+        openHeap.pop_back();
+        if (nodes[current].closed) {
+            continue;  // A cheaper copy was already expanded
+        }
+        nodes[current].closed = true;
+        expanded++;
+
+        int x = nodes[current].x;
+        int y = nodes[current].y;
+        if (x == toX && y == toY) {
+            goal = current;
+            break;
+        }
+        for (int d = 0; d < 4; d++) {
+            int nx = x + STEP_X[d];
+            int ny = y + STEP_Y[d];
+            int enter = stepCost(nx, ny);
+            if (enter == 0) continue;
+            int cost = nodes[current].cost + enter;
+            int next = findNode(nx, ny);
+            if (next == -1) {
+                next = addNode(nx, ny, cost, current);
+            } else if (nodes[next].closed || cost >= nodes[next].cost) {
+                continue;
+            } else {
+                nodes[next].cost = cost;
+                nodes[next].parent = current;
+            }
+            openHeap.push_back(make_pair(cost + abs(toX - nx) + abs(toY - ny), next));
+            push_heap(openHeap.begin(), openHeap.end(), later);
+        }
+    }
+
+    if (goal == -1) {
+        return -1;
+    }
+    for (int node = goal; node != -1; node = nodes[node].parent) {
+        MapPosition step = { nodes[node].x, nodes[node].y };
+        path.push_back(step);
+    }
+    reverse(path.begin(), path.end());
+    return nodes[goal].cost;
+}
+
+// Dijkstra outward from the target over the window around it
+void PathFinder::buildFlowField(FlowField& field) {
+    int left = field.targetX - FLOW_FIELD_RANGE;
+    int top = field.targetY - FLOW_FIELD_RANGE;
+    int right = field.targetX + FLOW_FIELD_RANGE;
+    int bottom = field.targetY + FLOW_FIELD_RANGE;
+    if (left < 0) left = 0;
+    if (top < 0) top = 0;
+    if (right >= tiles->getWidth()) right = tiles->getWidth() - 1;
+    if (bottom >= tiles->getHeight()) bottom = tiles->getHeight() - 1;
+    field.originX = left;
+    field.originY = top;
+    field.width = right - left + 1;
+    field.height = bottom - top + 1;
+    field.revision = revision;
+    field.costs.assign(field.width * field.height, -1);
+
+    if (stepCost(field.targetX, field.targetY) == 0) {
+        return;
+    }
+    std::greater<pair<int, int> > later;
+    openHeap.clear();
+    int targetCell = (field.targetY - top) * field.width + (field.targetX - left);
+    field.costs[targetCell] = 0;
+    openHeap.push_back(make_pair(0, targetCell));
+    while (!openHeap.empty()) {
+        pop_heap(openHeap.begin(), openHeap.end(), later);
+        int cost = openHeap.back().first;
+        int cell = openHeap.back().second;
+        openHeap.pop_back();
+        if (cost > field.costs[cell]) {
+            continue;
+        }
+        int x = left + cell % field.width;
+        int y = top + cell / field.width;
+        // Coming from a neighbour means paying to enter this tile
+        int enter = stepCost(x, y);
+        for (int d = 0; d < 4; d++) {
+            int nx = x + STEP_X[d];
+            int ny = y + STEP_Y[d];
+            if (nx < left || nx > right || ny < top || ny > bottom || stepCost(nx, ny) == 0) continue;
+            int next = (ny - top) * field.width + (nx - left);
+            if (field.costs[next] == -1 || cost + enter < field.costs[next]) {
+                field.costs[next] = cost + enter;
+                openHeap.push_back(make_pair(cost + enter, next));
+                push_heap(openHeap.begin(), openHeap.end(), later);
+            }
+        }
+    }
+}
+
+// Returns the cached field for the target, building it if needed
+const FlowField& PathFinder::getFlowField(int targetX, int targetY) {
+    flowClock++;
+    int oldest = 0;
+    for (size_t i = 0; i < flowFields.size(); i++) {
+        if (flowFields[i].targetX == targetX && flowFields[i].targetY == targetY) {
+            if (flowFields[i].revision != revision) {
+                buildFlowField(flowFields[i]);
+            }
+            flowFieldUsed[i] = flowClock;
+            return flowFields[i];
+        }
+        if (flowFieldUsed[i] < flowFieldUsed[oldest]) oldest = (int)i;
+    }
+
+    if ((int)flowFields.size() < FLOW_FIELD_CACHE) {
+        flowFields.push_back(FlowField());
+        flowFieldUsed.push_back(0);
+        oldest = (int)flowFields.size() - 1;
+    }
+    FlowField& field = flowFields[oldest];
+    field.targetX = targetX;
+    field.targetY = targetY;
+    buildFlowField(field);
+    flowFieldUsed[oldest] = flowClock;
+    return field;
+}
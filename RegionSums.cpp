@@ -0,0 +1,128 @@
+#include "MultiplayerSystems.h"
+
+const int SUM_STRIDE = MAP_CHUNK_SIZE + 1;
+
+RegionSums::RegionSums() : tiles(0), chunksX(0), chunksY(0) {
+}
+
+RegionSums::~RegionSums() {
+    clear();
+}
+
+// Forgets every table and matches the map's current size
+void RegionSums::attach(const TileMap* map) {
+    clear();
+    tiles = map;
+    chunksX = (map->getWidth() + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    chunksY = (map->getHeight() + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    chunkTable.assign(chunksX * chunksY, 0);
+}
+
+void RegionSums::clear() {
+    for (size_t i = 0; i < chunkTable.size(); i++) {
+        delete chunkTable[i];
+    }
+    chunkTable.assign(chunkTable.size(), 0);
+}
+
+RegionChunk* RegionSums::chunkAt(int chunkX, int chunkY) const {
+    RegionChunk*& chunk = chunkTable[chunkY * chunksX + chunkX];
+    if (chunk == 0) {
+        chunk = new RegionChunk();
+        chunk->dirty = true;
+    }
+    if (chunk->dirty) {
+        rebuild(chunkX, chunkY, *chunk);
+    }
+    return chunk;
+}
+
+// Tiles past the map edge count as zero
+void RegionSums::rebuild(int chunkX, int chunkY, RegionChunk& chunk) const {
+    int baseX = chunkX * MAP_CHUNK_SIZE;
+    int baseY = chunkY * MAP_CHUNK_SIZE;
+    for (int layer = 0; layer < REGION_LAYER_COUNT; layer++) {
+        int* table = chunk.sums[layer];
+        for (int x = 0; x < SUM_STRIDE; x++) {
+            table[x] = 0;
+        }
+        for (int y = 0; y < MAP_CHUNK_SIZE; y++) {
+            int* row = table + (y + 1) * SUM_STRIDE;
+            const int* above = row - SUM_STRIDE;
+            int rowTotal = 0;
+            row[0] = 0;
+            for (int x = 0; x < MAP_CHUNK_SIZE; x++) {
+                int value;
+                if (layer == REGION_YIELD) {
+                    value = tiles->inBounds(baseX + x, baseY + y) ? tiles->getTile(baseX + x, baseY + y).yield : 0;
+                } else {
+                    value = chunk.values[layer - 1][y * MAP_CHUNK_SIZE + x];
+                }
+                rowTotal += value;
+                row[x + 1] = above[x + 1] + rowTotal;
+            }
+        }
+    }
+    chunk.dirty = false;
+}
+
+// Call after a tile's terrain or yield changes
+void RegionSums::invalidate(int x, int y) {
+    if (!tiles || !tiles->inBounds(x, y)) {
+        return;
+    }
+    RegionChunk* chunk = chunkTable[(y / MAP_CHUNK_SIZE) * chunksX + x / MAP_CHUNK_SIZE];
+    if (chunk) {
+        chunk->dirty = true;
+    }
+}
+
+void RegionSums::setValue(RegionLayer layer, int x, int y, int value) {
+    if (layer == REGION_YIELD || !tiles || !tiles->inBounds(x, y)) {
+        return;
+    }
+    RegionChunk*& chunk = chunkTable[(y / MAP_CHUNK_SIZE) * chunksX + x / MAP_CHUNK_SIZE];
+    if (chunk == 0) {
+        chunk = new RegionChunk();
+        chunk->dirty = true;
+    }
+    int& slot = chunk->values[layer - 1][(y % MAP_CHUNK_SIZE) * MAP_CHUNK_SIZE + x % MAP_CHUNK_SIZE];
+    if (slot != value) {
+        slot = value;
+        chunk->dirty = true;
+    }
+}
+
+int RegionSums::getValue(RegionLayer layer, int x, int y) const {
+    return (int)sum(layer, x, y, x, y);
+}
+
+// Sum of a layer over the inclusive rectangle (x1,y1)-(x2,y2), clipped to the map
+long long RegionSums::sum(RegionLayer layer, int x1, int y1, int x2, int y2) const {
+    if (!tiles) {
+        return 0;
+    }
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    if (x2 >= tiles->getWidth()) x2 = tiles->getWidth() - 1;
+    if (y2 >= tiles->getHeight()) y2 = tiles->getHeight() - 1;
+    if (x1 > x2 || y1 > y2) {
+        return 0;
+    }
+
+    long long total = 0;
+    for (int cy = y1 / MAP_CHUNK_SIZE; cy <= y2 / MAP_CHUNK_SIZE; cy++) {
+        int top = cy * MAP_CHUNK_SIZE;
+        int ly1 = (y1 > top ? y1 : top) - top;
+        int ly2 = (y2 < top + MAP_CHUNK_SIZE - 1 ? y2 : top + MAP_CHUNK_SIZE - 1) - top;
+        for (int cx = x1 / MAP_CHUNK_SIZE; cx <= x2 / MAP_CHUNK_SIZE; cx++) {
+            int left = cx * MAP_CHUNK_SIZE;
+            int lx1 = (x1 > left ? x1 : left) - left;
+            int lx2 = (x2 < left + MAP_CHUNK_SIZE - 1 ? x2 : left + MAP_CHUNK_SIZE - 1) - left;
+            const int* table = chunkAt(cx, cy)->sums[layer];
+            total += table[(ly2 + 1) * SUM_STRIDE + lx2 + 1] - table[ly1 * SUM_STRIDE + lx2 + 1]
+                   - table[(ly2 + 1) * SUM_STRIDE + lx1] + table[ly1 * SUM_STRIDE + lx1];
+        }
+    }
+    return total;
+}
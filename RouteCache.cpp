@@ -0,0 +1,96 @@
+#include "MultiplayerSystems.h"
+#include <cstdlib>
+
+RouteCache::RouteCache() : paths(0), searches(0) {
+    clear();
+}
+
+void RouteCache::attach(PathFinder* finder) {
+    paths = finder;
+    clear();
+}
+
+// Forgets every seat and route
+void RouteCache::clear() {
+    for (int a = 0; a < MAX_KINGDOMS; a++) {
+        seatPositions[a].x = -1;
+        seatPositions[a].y = -1;
+        for (int b = 0; b < MAX_KINGDOMS; b++) {
+            costs[a][b] = -1;
+            stale[a][b] = true;
+            routes[a][b].clear();
+        }
+    }
+}
+
+// Only the routes to and from this kingdom are searched again
+void RouteCache::setSeat(int kingdom, int x, int y) {
+    if (kingdom < 0 || kingdom >= MAX_KINGDOMS) {
+        return;
+    }
+    seatPositions[kingdom].x = x;
+    seatPositions[kingdom].y = y;
+    for (int other = 0; other < MAX_KINGDOMS; other++) {
+        stale[kingdom][other] = true;
+        stale[other][kingdom] = true;
+    }
+}
+
+// Every step costs at least 1, so a tile can only shorten a route if the
+// detour through it is shorter than the route in straight-line steps
+void RouteCache::tileChanged(int x, int y, int oldCost, int newCost) {
+    if (oldCost == newCost) {
+        return;
+    }
+    bool cheaper = newCost > 0 && (oldCost == 0 || newCost < oldCost);
+    for (int a = 0; a < MAX_KINGDOMS; a++) {
+        for (int b = a + 1; b < MAX_KINGDOMS; b++) {
+            if (stale[a][b] || seatPositions[a].x == -1 || seatPositions[b].x == -1) {
+                continue;
+            }
+            bool affected = false;
+            if (cheaper) {
+                int detour = abs(seatPositions[a].x - x) + abs(seatPositions[a].y - y)
+                           + abs(seatPositions[b].x - x) + abs(seatPositions[b].y - y);
+                affected = costs[a][b] == -1 || detour < costs[a][b];
+            } else {
+                const vector<MapPosition>& route = routes[a][b];
+                for (size_t i = 0; i < route.size() && !affected; i++) {
+                    affected = route[i].x == x && route[i].y == y;
+                }
+            }
+            if (affected) {
+                stale[a][b] = true;
+                stale[b][a] = true;
+            }
+        }
+    }
+}
+
+// Cost of the cheapest land route between two seats, or -1 if there is none
+int RouteCache::getCost(int kingdomA, int kingdomB) {
+    if (kingdomA < 0 || kingdomA >= MAX_KINGDOMS || kingdomB < 0 || kingdomB >= MAX_KINGDOMS) {
+        return -1;
+    }
+    getRoute(kingdomA, kingdomB);
+    return costs[kingdomA][kingdomB];
+}
+
+const vector<MapPosition>& RouteCache::getRoute(int kingdomA, int kingdomB) {
+    int low = kingdomA < kingdomB ? kingdomA : kingdomB;
+    int high = kingdomA < kingdomB ? kingdomB : kingdomA;
+    if (stale[low][high]) {
+        int cost = -1;
+        routes[low][high].clear();
+        if (low == high) {
+            cost = 0;
+        } else if (paths && seatPositions[low].x != -1 && seatPositions[high].x != -1) {
+            cost = paths->findPath(seatPositions[low].x, seatPositions[low].y,
+                                   seatPositions[high].x, seatPositions[high].y, routes[low][high]);
+            searches++;
+        }
+        costs[low][high] = costs[high][low] = cost;
+        stale[low][high] = stale[high][low] = false;
+    }
+    return routes[low][high];
+}
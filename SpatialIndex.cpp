@@ -0,0 +1,184 @@
+#include "MultiplayerSystems.h"
+#include <algorithm>
+#include <cstdlib>
+
+SpatialIndex::SpatialIndex(int cellSize) : bucketSize(cellSize), entryCount(0) {
+}
+
+void SpatialIndex::clear() {
+    buckets.clear();
+    positions.clear();
+    entryCount = 0;
+}
+
+long long SpatialIndex::bucketKey(int bucketX, int bucketY) const {
+    return ((long long)bucketY << 32) | (unsigned int)bucketX;
+}
+
+void SpatialIndex::insert(int id, int x, int y) {
+    if (id >= (int)positions.size()) {
+        MapPosition unused = { -1, -1 };
+        positions.resize(id + 1, unused);
+    }
+    if (positions[id].x != -1) {
+        remove(id);
+    }
+    positions[id].x = x;
+    positions[id].y = y;
+    buckets[bucketKey(x / bucketSize, y / bucketSize)].push_back(id);
+    entryCount++;
+}
+
+void SpatialIndex::remove(int id) {
+    if (id < 0 || id >= (int)positions.size() || positions[id].x == -1) {
+        return;
+    }
+    long long key = bucketKey(positions[id].x / bucketSize, positions[id].y / bucketSize);
+    vector<int>& bucket = buckets[key];
+    for (size_t i = 0; i < bucket.size(); i++) {
+        if (bucket[i] == id) {
+            bucket[i] = bucket.back();
+            bucket.pop_back();
+            break;
+        }
+    }
+    if (bucket.empty()) {
+        buckets.erase(key);
+    }
+    positions[id].x = -1;
+    positions[id].y = -1;
+    entryCount--;
+}
+
+// Only touches the two buckets involved
+void SpatialIndex::move(int id, int newX, int newY) {
+    remove(id);
+    insert(id, newX, newY);
+}
+
+// Returns (-1,-1) for ids that are not stored
+MapPosition SpatialIndex::getPosition(int id) const {
+    if (id < 0 || id >= (int)positions.size()) {
+        MapPosition unused = { -1, -1 };
+        return unused;
+    }
+    return positions[id];
+}
+
+int SpatialIndex::occupantAt(int x, int y) const {
+    std::unordered_map<long long, vector<int> >::const_iterator it =
+        buckets.find(bucketKey(x / bucketSize, y / bucketSize));
+    if (it == buckets.end()) {
+        return -1;
+    }
+    const vector<int>& bucket = it->second;
+    for (size_t i = 0; i < bucket.size(); i++) {
+        if (positions[bucket[i]].x == x && positions[bucket[i]].y == y) {
+            return bucket[i];
+        }
+    }
+    return -1;
+}
+
+void SpatialIndex::scanBucket(int bucketX, int bucketY, int x, int y, int distance, vector<int>& found) const {
+    std::unordered_map<long long, vector<int> >::const_iterator it = buckets.find(bucketKey(bucketX, bucketY));
+    if (it == buckets.end()) {
+        return;
+    }
+    const vector<int>& bucket = it->second;
+    for (size_t i = 0; i < bucket.size(); i++) {
+        const MapPosition& p = positions[bucket[i]];
+        if (abs(p.x - x) + abs(p.y - y) <= distance) {
+            found.push_back(bucket[i]);
+        }
+    }
+}
+
+// Every kingdom within the given distance of (x,y), the one at (x,y) included
+void SpatialIndex::findWithin(int x, int y, int distance, vector<int>& found) const {
+    found.clear();
+    int minBucketX = (x - distance < 0 ? 0 : x - distance) / bucketSize;
+    int minBucketY = (y - distance < 0 ? 0 : y - distance) / bucketSize;
+    int maxBucketX = (x + distance) / bucketSize;
+    int maxBucketY = (y + distance) / bucketSize;
+    for (int by = minBucketY; by <= maxBucketY; by++) {
+        for (int bx = minBucketX; bx <= maxBucketX; bx++) {
+            scanBucket(bx, by, x, y, distance, found);
+        }
+    }
+}
+
+// Every kingdom inside the inclusive rectangle (x1,y1)-(x2,y2)
+void SpatialIndex::findInRect(int x1, int y1, int x2, int y2, vector<int>& found) const {
+    found.clear();
+    if (x1 < 0) x1 = 0;
+    if (y1 < 0) y1 = 0;
+    for (int by = y1 / bucketSize; by <= y2 / bucketSize; by++) {
+        for (int bx = x1 / bucketSize; bx <= x2 / bucketSize; bx++) {
+            std::unordered_map<long long, vector<int> >::const_iterator it = buckets.find(bucketKey(bx, by));
+            if (it == buckets.end()) continue;
+            for (size_t i = 0; i < it->second.size(); i++) {
+                const MapPosition& p = positions[it->second[i]];
+                if (p.x >= x1 && p.x <= x2 && p.y >= y1 && p.y <= y2) {
+                    found.push_back(it->second[i]);
+                }
+            }
+        }
+    }
+}
+
+struct RankedKingdom {
+    int distance;
+    int id;
+    bool operator<(const RankedKingdom& other) const {
+        return distance < other.distance || (distance == other.distance && id < other.id);
+    }
+};
+
+// The count closest kingdoms, nearest first. Searches rings of buckets
+// outward and stops once no further ring can hold anything closer
+void SpatialIndex::findNearest(int x, int y, int count, vector<int>& found) const {
+    found.clear();
+    if (count <= 0 || entryCount == 0) {
+        return;
+    }
+    int centerX = x / bucketSize;
+    int centerY = y / bucketSize;
+    vector<RankedKingdom> candidates;
+    int seen = 0;
+
+    for (int ring = 0; ; ring++) {
+        for (int by = centerY - ring; by <= centerY + ring; by++) {
+            for (int bx = centerX - ring; bx <= centerX + ring; bx++) {
+                if (bx < 0 || by < 0) continue;
+                if (abs(bx - centerX) != ring && abs(by - centerY) != ring) continue;
+                std::unordered_map<long long, vector<int> >::const_iterator it = buckets.find(bucketKey(bx, by));
+                if (it == buckets.end()) continue;
+                for (size_t i = 0; i < it->second.size(); i++) {
+                    int id = it->second[i];
+                    RankedKingdom candidate;
+                    candidate.distance = abs(positions[id].x - x) + abs(positions[id].y - y);
+                    candidate.id = id;
+                    candidates.push_back(candidate);
+                    seen++;
+                }
+            }
+        }
+
+        if (seen == entryCount) {
+            break;
+        }
+        // Anything in the next ring is at least ring * bucketSize + 1 away
+        if ((int)candidates.size() >= count) {
+            std::nth_element(candidates.begin(), candidates.begin() + (count - 1), candidates.end());
+            if (candidates[count - 1].distance <= ring * bucketSize) {
+                break;
+            }
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+    for (int i = 0; i < count && i < (int)candidates.size(); i++) {
+        found.push_back(candidates[i].id);
+    }
+}
@@ -4,6 +4,9 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <queue>
+#include <sstream>
 using namespace std;
 
 class Army;
@@ -13,6 +16,9 @@ class Bank;
 class ResourceManager;
 class EventManager;
 class Leader;
+class EpidemicSystem;
+struct KingdomData;
+struct KingdomResources;
 
 class Person {
 protected:
@@ -44,6 +50,92 @@ public:
     virtual void showStatus() const;
 };
 
+// Social classes, in the order they are stored in the cohort arrays
+enum SocialClassId {
+    CLASS_PEASANT,
+    CLASS_MERCHANT,
+    CLASS_NOBLE,
+    SOCIAL_CLASS_COUNT
+};
+
+const int AGE_BANDS = 16;       // 5-year bands, the last one is 75+
+const int YEARS_PER_BAND = 5;
+const int COHORTS_PER_KINGDOM = SOCIAL_CLASS_COUNT * AGE_BANDS;
+
+// Bump allocator that carves one kingdom's citizen arrays out of a
+// single block, so they sit next to each other in memory
+class CitizenArena {
+private:
+    char* buffer;
+    size_t capacity;
+    size_t used;
+
+    CitizenArena(const CitizenArena&);
+    CitizenArena& operator=(const CitizenArena&);
+public:
+    CitizenArena();
+    ~CitizenArena();
+    void reserve(size_t bytes);
+    void* allocate(size_t bytes, size_t alignment);
+    void reset();
+    size_t getUsed() const { return used; }
+    size_t getCapacity() const { return capacity; }
+};
+
+// Individual citizens of one kingdom stored as packed component arrays
+// instead of one Person object each. Citizens are moved around on removal,
+// so an index is only valid until the next removal
+class CitizenStore {
+private:
+    CitizenArena arena;
+    int capacity;
+    int count;
+    unsigned int* ids;
+    unsigned char* ages;
+    unsigned char* classes;
+    unsigned char* employed;
+    int* wealth;
+
+public:
+    CitizenStore();
+    void init(int maxCitizens);
+    int spawn(unsigned int id, int age, int socialClass, int startingWealth);
+    void remove(int index);
+    int getCount() const { return count; }
+    int getCapacity() const { return capacity; }
+    int getAge(int index) const { return ages[index]; }
+    int getSocialClass(int index) const { return classes[index]; }
+    bool isEmployed(int index) const { return employed[index] != 0; }
+    int getWealth(int index) const { return wealth[index]; }
+
+    friend class CitizenWorld;
+};
+
+// Runs the bulk systems (ageing, jobs, taxes, migration) over every
+// kingdom's citizens. Only the benchmarks build one so far; the game
+// itself still counts people in cohorts
+class CitizenWorld {
+private:
+    CitizenStore* stores;
+    int kingdomCount;
+    unsigned int nextId;
+    unsigned int randomState;
+
+    unsigned int nextRandom();
+    CitizenWorld(const CitizenWorld&);
+    CitizenWorld& operator=(const CitizenWorld&);
+public:
+    CitizenWorld(int kingdoms, int citizensPerKingdom);
+    ~CitizenWorld();
+    CitizenStore& getStore(int kingdom) { return stores[kingdom]; }
+    int getKingdomCount() const { return kingdomCount; }
+    void populateFrom(int kingdom, const Population& pop);
+    int ageAll();
+    void assignEmployment(float employmentRate);
+    int collectTaxes(int kingdom, float taxRate);
+    int migrate(int fromKingdom, int toKingdom, int maxCitizens);
+};
+
 // Population class handles all citizen-related stuff
 class Population {
 private:
@@ -53,9 +145,27 @@ private:
     int nobleCount;
     int foodReserves;
     float citizenHappiness;
+    // People per class and age band, one class after another
+    float cohorts[COHORTS_PER_KINGDOM];
+    // Figures worked out from the counts, redone only after they change
+    mutable bool derivedDirty;
+    mutable float classRatios[SOCIAL_CLASS_COUNT];
+    mutable int recruitableCount;
+
+    void refreshDerived() const;
+    void syncCountsFromCohorts();
+    void scaleCohorts(int newTotal);
 public:
     Population();
     void simulate();
+    void advanceCohorts();
+    void rebuildCohorts();
+    int getRecruitableCount() const;
+    float getClassRatio(int socialClass) const;
+    float getCohort(int socialClass, int ageBand) const { return cohorts[socialClass * AGE_BANDS + ageBand]; }
+    static void advanceCohortBatch(float* cohortData, const float* happiness, int kingdomCount);
+    static void fitCohorts(float* cohortData, int total);
+    static float cohortTotal(const float* cohortData);
     void showStats() const;
     void saveToFile() const;
     void loadFromFile();
@@ -68,10 +178,10 @@ public:
     int getFoodReserves() const { return foodReserves; }
     float getHappiness() const { return citizenHappiness; }
     
-    void setTotal(int value) { totalPopulation = value; }
-    void setPeasantCount(int value) { peasantCount = value; }
-    void setMerchantCount(int value) { merchantCount = value; }
-    void setNobleCount(int value) { nobleCount = value; }
+    void setTotal(int value) { totalPopulation = value; derivedDirty = true; }
+    void setPeasantCount(int value) { peasantCount = value; derivedDirty = true; }
+    void setMerchantCount(int value) { merchantCount = value; derivedDirty = true; }
+    void setNobleCount(int value) { nobleCount = value; derivedDirty = true; }
     void setFoodReserves(int value) { foodReserves = value; }
     void setHappiness(float value) { citizenHappiness = value; }
 };
@@ -128,8 +238,13 @@ class Bank {
 private:
     int activeLoans;
     int detectedFraud;
+    // Safe loan limit for the treasury it was worked out for
+    mutable bool limitDirty;
+    mutable int limitTreasury;
+    mutable double safeLoanLimit;
 public:
     Bank();
+    double getSafeLoanLimit(const Economy& economy) const;
     void auditTreasury(Economy& economy);
     void issueLoan(Economy& economy, int amount);
     void repayLoan(Economy& economy, int amount);
@@ -140,17 +255,23 @@ public:
     int getActiveLoans() const { return activeLoans; }
     int getDetectedFraud() const { return detectedFraud; }
     
-    void setActiveLoans(int value) { activeLoans = value; }
+    void setActiveLoans(int value) { activeLoans = value; limitDirty = true; }
     void setDetectedFraud(int value) { detectedFraud = value; }
 };
 
-// Manages all the resources in the game
+// Manages all the resources in the game. Stocks grow by a fixed amount every
+// turn; they are kept as of lastUpdatedTurn and the growth since then is
+// worked out when they are read, and folded in when something changes them
 class ResourceManager {
 private:
     int foodStock;
     int timberStock;
     int stoneStock;
     int metalStock;
+    int lastUpdatedTurn;
+
+    int turnsSinceUpdate() const;
+    void settle();
 public:
     ResourceManager();
     void manage();
@@ -161,22 +282,164 @@ public:
     void loadFromFile();
     void consumeFixed(string resourceType, int amount);
     
-    int getFoodStock() const { return foodStock; }
-    int getTimberStock() const { return timberStock; }
-    int getStoneStock() const { return stoneStock; }
-    int getMetalStock() const { return metalStock; }
+    int getFoodStock() const;
+    int getTimberStock() const;
+    int getStoneStock() const;
+    int getMetalStock() const;
     
-    void setFoodStock(int value) { foodStock = value; }
-    void setTimberStock(int value) { timberStock = value; }
-    void setStoneStock(int value) { stoneStock = value; }
-    void setMetalStock(int value) { metalStock = value; }
+    void setFoodStock(int value) { settle(); foodStock = value; }
+    void setTimberStock(int value) { settle(); timberStock = value; }
+    void setStoneStock(int value) { settle(); stoneStock = value; }
+    void setMetalStock(int value) { settle(); metalStock = value; }
+};
+
+// Built-in random events, also used as indexes into the event tables
+enum EventType {
+    EVENT_FAMINE,
+    EVENT_DISEASE,
+    EVENT_WAR,
+    EVENT_BETRAYAL,
+    EVENT_EARTHQUAKE,
+    BUILTIN_EVENT_COUNT
+};
+
+const int MAX_EVENT_TYPES = 1024;
+const int REALM_KINGDOM_ID = 0;
+
+// Kingdom values that data-driven events can test and change
+enum EventStat {
+    STAT_POPULATION,
+    STAT_HAPPINESS,
+    STAT_SOLDIERS,
+    STAT_MORALE,
+    STAT_TREASURY,
+    STAT_FOOD,
+    STAT_WOOD,
+    STAT_STONE,
+    STAT_METAL,
+    EVENT_STAT_COUNT
+};
+
+const int MAX_EVENT_CONDITIONS = 4;
+
+// Keeps track of the current game turn
+class GameClock {
+private:
+    static int currentTurn;
+public:
+    static int now();
+    static void advance();
+    static void set(int turn);
+};
+
+// One event that has been drawn ahead of time for a kingdom
+struct ScheduledEvent {
+    int dueTurn;
+    int kingdomId;
+    int eventType;
+};
+
+// Orders the queue so the earliest due event is on top
+struct LaterEvent {
+    bool operator()(const ScheduledEvent& a, const ScheduledEvent& b) const {
+        return a.dueTurn > b.dueTurn;
+    }
+};
+
+// Draws the next occurrence of every event type for every kingdom
+// from per-turn hazard rates and keeps them in a priority queue
+class EventScheduler {
+private:
+    priority_queue<ScheduledEvent, vector<ScheduledEvent>, LaterEvent> upcoming;
+    double hazardRates[MAX_EVENT_TYPES];
+    int eventTypeCount;
+    vector<int> kingdomIds;
+
+    int drawDelay(double ratePerTurn) const;
+    void schedule(int kingdomId, int eventType, int fromTurn);
+    void dropEvents(int kingdomId, int eventType);
+public:
+    EventScheduler();
+    void setHazardRate(int eventType, double ratePerTurn, int currentTurn);
+    double getHazardRate(int eventType) const;
+    void addKingdom(int kingdomId, int currentTurn);
+    void removeKingdom(int kingdomId);
+    bool popDue(int currentTurn, ScheduledEvent& event);
+    int nextDueTurn() const;
+    bool empty() const;
+};
+
+// Event definitions loaded from a data file and compiled into flat tables.
+// Every event has the same number of condition slots and a full row of stat
+// deltas, so checking and applying events is plain array arithmetic
+class EventTable {
+private:
+    int eventCount;
+    vector<string> titles;
+    vector<string> texts;
+    vector<double> rates;
+    vector<unsigned char> conditionStats;
+    vector<int> conditionMin;
+    vector<int> conditionMax;
+    vector<int> effectDeltas;
+    vector<float> outbreakShares;
+
+    int addEvent(const string& title);
+public:
+    EventTable();
+    bool loadFromFile(const string& fileName);
+    int getEventCount() const;
+    string getTitle(int eventId) const;
+    string getText(int eventId) const;
+    double getRate(int eventId) const;
+    float getOutbreakShare(int eventId) const;
+    bool conditionsMet(int eventId, const int* stats) const;
+    void applyEffects(int eventId, int* stats) const;
+    static int findStat(const string& name);
 };
 
 // Handles random events that can happen in the game
 class EventManager {
+private:
+    typedef void (EventManager::*EventHandler)(int, Population&, Army&, Economy&, ResourceManager&);
+
+    EventHandler handlers[MAX_EVENT_TYPES];
+    int handlerCount;
+    EventScheduler scheduler;         // The realm only
+    EventScheduler kingdomScheduler;  // Multiplayer kingdoms, by index in kingdoms[]
+    int kingdomsScheduled;
+    EventTable definitions;
+    EpidemicSystem* epidemic;
+    int realmX;
+    int realmY;
+    float plagueDeathCarry;
+
+    void registerBuiltinEvents();
+    void registerHandler(int eventType, EventHandler handler);
+    string getTitle(int eventType) const;
+    void fireDueEvents(Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void spreadEpidemic(Population& pop);
+    void handleFamine(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void handleDisease(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void handleWar(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void handleBetrayal(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void handleEarthquake(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void handleDefinedEvent(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void readStats(const Population& pop, const Army& army, const Economy& eco, const ResourceManager& res, int* stats) const;
+    void writeStats(const int* stats, Population& pop, Army& army, Economy& eco, ResourceManager& res) const;
+    void readKingdomStats(const KingdomResources& resources, int* stats) const;
+    void writeKingdomStats(const int* stats, KingdomResources& resources) const;
+    void applyBuiltinEvent(int eventType, const KingdomData& kingdom, int* stats);
 public:
     EventManager();
     void trigger(Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void fire(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void advanceTurn(Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void skipToNextEvent(Population& pop, Army& army, Economy& eco, ResourceManager& res);
+    void setHazardRate(int eventType, double ratePerTurn);
+    void attachEpidemic(EpidemicSystem* system, int x, int y);
+    void scheduleKingdoms(int count);
+    bool fireKingdomEvents(KingdomData* kingdoms, int count);
     void famine(ResourceManager& res, Population& pop);
     void disease(Population& pop);
     void war(Army& army, Economy& eco);
@@ -184,6 +447,241 @@ public:
     void earthquake(ResourceManager& res);
 };
 
+// Console output layer. Screens are composed in memory and written with a
+// single system call instead of one flushed line at a time. In redraw mode
+// (--tui) the main menu is kept at the top of the terminal and only the
+// lines that changed since the last frame are rewritten
+class ScreenBuffer {
+private:
+    ostringstream pending;
+    vector<string> lastFrame;
+    bool redraw;
+    int holdDepth;
+    int linesBelowFrame;     // Lines printed since the frame, to notice scrolling
+    streambuf* consoleBuf;   // cout's own buffer while lines are being counted
+    streambuf* countingBuf;
+
+    string takePending();
+    void writeOut(const string& text);
+    int terminalRows() const;
+    ScreenBuffer(const ScreenBuffer&);
+    ScreenBuffer& operator=(const ScreenBuffer&);
+
+public:
+    ScreenBuffer();
+    ~ScreenBuffer();
+    static ScreenBuffer& console();
+
+    template <typename T>
+    ScreenBuffer& operator<<(const T& value) {
+        pending << value;
+        return *this;
+    }
+
+    void setRedraw(bool enabled);
+    bool isRedraw() const { return redraw; }
+    void hold();
+    void release();
+    void present();
+    void presentFrame();
+    void clearBelow();
+};
+
+// Chrome trace recorder. TRACE_SCOPE("name") times the rest of the block
+// it sits in while tracing is on (--trace <file>); building with
+// STRONGHOLD_NO_TRACE removes every scope. Each thread records into its own
+// buffer, so scopes never take a lock, and the whole trace is written as
+// trace-event JSON for chrome://tracing or Perfetto
+class TraceLog {
+private:
+    static bool enabled;
+    static string outputFile;
+
+    static void dumpAtExit();
+
+public:
+    static void enable(const string& fileName);
+    static bool isEnabled() { return enabled; }
+    static long long now();
+    static void record(const char* name, long long start, long long duration);
+    static bool dump(const string& fileName);
+    static bool dump() { return dump(outputFile); }
+};
+
+class TraceScope {
+private:
+    const char* name;
+    long long start;
+    TraceScope(const TraceScope&);
+    TraceScope& operator=(const TraceScope&);
+
+public:
+    explicit TraceScope(const char* scopeName)
+        : name(scopeName), start(TraceLog::isEnabled() ? TraceLog::now() : -1) {
+    }
+    ~TraceScope() {
+        if (start >= 0) {
+            TraceLog::record(name, start, TraceLog::now() - start);
+        }
+    }
+};
+
+#define SCOPE_CONCAT_INNER(a, b) a##b
+#define SCOPE_CONCAT(a, b) SCOPE_CONCAT_INNER(a, b)
+
+#ifdef STRONGHOLD_NO_TRACE
+#define TRACE_SCOPE(name)
+#else
+#define TRACE_SCOPE(name) TraceScope SCOPE_CONCAT(traceScope, __LINE__)(name)
+#endif
+
+// Parts of the game that heap allocations are charged to
+enum Subsystem {
+    SUBSYSTEM_OTHER,
+    SUBSYSTEM_POPULATION,
+    SUBSYSTEM_ARMY,
+    SUBSYSTEM_ECONOMY,
+    SUBSYSTEM_RESOURCES,
+    SUBSYSTEM_EVENTS,
+    SUBSYSTEM_KINGDOMS,
+    SUBSYSTEM_WAR,
+    SUBSYSTEM_TRADE,
+    SUBSYSTEM_ALLIANCE,
+    SUBSYSTEM_MESSAGES,
+    SUBSYSTEM_MAP,
+    SUBSYSTEM_EPIDEMIC,
+    SUBSYSTEM_SAVE_LOAD,
+    SUBSYSTEM_COUNT
+};
+
+// Heap accounting. The global operator new charges every allocation and
+// its bytes to the innermost ALLOCATION_SCOPE on the calling thread, and
+// delete gives the bytes back to whoever allocated them. Strings passed
+// by value are built by the caller, so they count against the caller.
+// Building with STRONGHOLD_NO_ALLOC_TRACKING leaves operator new alone
+class AllocationStats {
+private:
+    static bool reportTurns;
+
+public:
+    static int enter(int subsystem);
+    static void leave(int previous);
+    static void charge(int subsystem, size_t bytes);
+    static void release(int subsystem, size_t bytes);
+    static unsigned long long getAllocations();
+    static unsigned long long getAllocations(int subsystem);
+    static long long getLiveBytes();
+    static long long getPeakLiveBytes();
+    static const char* subsystemName(int subsystem);
+    static void setTurnReports(bool enabled) { reportTurns = enabled; }
+    static void endTurn();
+    static void report(ostream& out);
+};
+
+class AllocationScope {
+private:
+    int previous;
+    AllocationScope(const AllocationScope&);
+    AllocationScope& operator=(const AllocationScope&);
+
+public:
+    explicit AllocationScope(int subsystem) : previous(AllocationStats::enter(subsystem)) {
+    }
+    ~AllocationScope() {
+        AllocationStats::leave(previous);
+    }
+};
+
+#ifdef STRONGHOLD_NO_ALLOC_TRACKING
+#define ALLOCATION_SCOPE(subsystem)
+#else
+#define ALLOCATION_SCOPE(subsystem) AllocationScope SCOPE_CONCAT(allocationScope, __LINE__)(subsystem)
+#endif
+
+// Game metrics, one slot per metric. Counters only go up, gauges hold
+// the latest value and histograms bucket latencies in seconds
+enum MetricId {
+    METRIC_TURNS,
+    METRIC_TURN_RATE,
+    METRIC_TRADES_OFFERED,
+    METRIC_TRADES_MATCHED,
+    METRIC_BATTLES,
+    METRIC_MESSAGES_SENT,
+    METRIC_EVENTS_FIRED,
+    METRIC_SAVE_SECONDS,
+    METRIC_LOAD_SECONDS,
+    METRIC_HEAP_LIVE_BYTES,
+    METRIC_KINGDOM_POPULATION,
+    METRIC_COUNT
+};
+
+enum MetricKind { METRIC_COUNTER, METRIC_GAUGE, METRIC_HISTOGRAM };
+
+const int METRIC_BUCKETS = 6;          // Last bucket is +Inf
+const int METRIC_HISTORY_TURNS = 1024; // Turns kept between exports
+
+// What each metric did during one turn: counters hold the turn's increase,
+// gauges their value at the end of it, histograms how many observations
+// and their total
+struct MetricTurnSample {
+    int turn;
+    double values[METRIC_COUNT];
+    double sums[METRIC_COUNT];
+};
+
+// Metrics registry. The hot paths update it directly; every turn closes a
+// sample into a ring buffer, and with --metrics <prefix> the samples are
+// appended to <prefix>.csv under a run id and the running totals written
+// to <prefix>.prom in Prometheus text format every few turns and at exit.
+// Updated from the game thread only
+class Metrics {
+private:
+    static double values[METRIC_COUNT];
+    static double sums[METRIC_COUNT];
+    static long long buckets[METRIC_COUNT][METRIC_BUCKETS];
+    static double turnStartValues[METRIC_COUNT];
+    static double turnStartSums[METRIC_COUNT];
+    static MetricTurnSample history[METRIC_HISTORY_TURNS];
+    static int historyCount;    // Samples waiting to be exported
+    static int historyStart;
+    static int turnsClosed;
+    static long long lastTurnEnd;
+    static string filePrefix;
+    static int exportInterval;
+    static bool exporting;
+    static long long runId;
+
+    static void exportAtExit();
+    static bool writeCsv();
+    static bool writePrometheus();
+
+public:
+    static void enable(const string& prefix, int everyTurns);
+    static void increment(int metric, long long amount = 1) { values[metric] += amount; }
+    static void set(int metric, double value) { values[metric] = value; }
+    static void observe(int metric, double seconds);
+    static double get(int metric) { return values[metric]; }
+    static long long now();
+    static void endTurn(int turnsPassed = 1);
+    static bool exportNow();
+};
+
+// Observes how long the rest of its block took
+class MetricTimer {
+private:
+    int metric;
+    long long start;
+    MetricTimer(const MetricTimer&);
+    MetricTimer& operator=(const MetricTimer&);
+
+public:
+    explicit MetricTimer(int metricId) : metric(metricId), start(Metrics::now()) {
+    }
+    ~MetricTimer() {
+        Metrics::observe(metric, (Metrics::now() - start) / 1e9);
+    }
+};
+
 // Base class for different types of rulers
 class Leader {
 protected:
@@ -0,0 +1,96 @@
+#include "MultiplayerSystems.h"
+
+// Salts keep the different noise layers independent of each other
+const unsigned int ELEVATION_SALT = 0x9E3779B9u;
+const unsigned int MOISTURE_SALT = 0x85EBCA6Bu;
+const unsigned int RIVER_SALT = 0xC2B2AE35u;
+const unsigned int DEPOSIT_SALT = 0x27D4EB2Fu;
+
+// One in this many land tiles sits on an ore or stone deposit
+const int DEPOSIT_RARITY = 64;
+const int DEPOSIT_YIELD = 3;
+
+TerrainGenerator::TerrainGenerator(unsigned int worldSeed) : seed(worldSeed) {
+}
+
+// Hashes a lattice point to a value in [0, 1)
+float TerrainGenerator::latticeValue(int x, int y, unsigned int salt) const {
+    unsigned int h = seed ^ salt;
+    h ^= (unsigned int)x * 0x27D4EB2Du;
+    h = (h ^ (h >> 15)) * 0x2C1B3C6Du;
+    h ^= (unsigned int)y * 0x165667B1u;
+    h = (h ^ (h >> 12)) * 0x297A2D39u;
+    h ^= h >> 15;
+    return (h & 0xFFFFFF) / 16777216.0f;
+}
+
+// Value noise: lattice values blended with a smoothstep curve
+float TerrainGenerator::smoothNoise(float x, float y, unsigned int salt) const {
+    int x0 = (int)x;
+    int y0 = (int)y;
+    float fx = x - x0;
+    float fy = y - y0;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+
+    float top = latticeValue(x0, y0, salt) * (1 - fx) + latticeValue(x0 + 1, y0, salt) * fx;
+    float bottom = latticeValue(x0, y0 + 1, salt) * (1 - fx) + latticeValue(x0 + 1, y0 + 1, salt) * fx;
+    return top * (1 - fy) + bottom * fy;
+}
+
+// Three octaves of value noise, the first one scale tiles wide
+float TerrainGenerator::fractalNoise(int x, int y, int scale, unsigned int salt) const {
+    float total = 0;
+    float weight = 1.0f;
+    float weights = 0;
+    float size = (float)scale;
+    for (int octave = 0; octave < 3; octave++) {
+        total += smoothNoise(x / size, y / size, salt + octave) * weight;
+        weights += weight;
+        weight *= 0.5f;
+        size *= 0.5f;
+    }
+    return total / weights;
+}
+
+MapTile TerrainGenerator::generateTile(int x, int y) const {
+    float elevation = fractalNoise(x, y, 48, ELEVATION_SALT);
+    float moisture = fractalNoise(x, y, 32, MOISTURE_SALT);
+    float river = fractalNoise(x, y, 64, RIVER_SALT);
+
+    TerrainType terrain;
+    if (elevation < 0.38f) {
+        terrain = TERRAIN_OCEAN;
+    } else if (elevation > 0.72f) {
+        terrain = TERRAIN_MOUNTAINS;
+    } else if (elevation > 0.62f) {
+        terrain = TERRAIN_HILLS;
+    } else if (river > 0.485f && river < 0.515f) {
+        // Rivers follow the middle contour of a separate noise layer
+        terrain = TERRAIN_RIVER_VALLEY;
+    } else if (moisture > 0.55f) {
+        terrain = TERRAIN_FOREST;
+    } else {
+        terrain = TERRAIN_PLAINS;
+    }
+
+    MapTile tile;
+    tile.terrain = (unsigned char)terrain;
+    tile.yield = (unsigned char)TERRAIN_INFO[terrain].yield;
+    tile.owner = -1;
+    if (terrain != TERRAIN_OCEAN &&
+        (int)(latticeValue(x, y, DEPOSIT_SALT) * DEPOSIT_RARITY) == 0) {
+        tile.yield += DEPOSIT_YIELD;
+    }
+    return tile;
+}
+
+void TerrainGenerator::fillChunk(int chunkX, int chunkY, MapChunk& chunk) const {
+    int baseX = chunkX * MAP_CHUNK_SIZE;
+    int baseY = chunkY * MAP_CHUNK_SIZE;
+    for (int y = 0; y < MAP_CHUNK_SIZE; y++) {
+        for (int x = 0; x < MAP_CHUNK_SIZE; x++) {
+            chunk.tiles[y * MAP_CHUNK_SIZE + x] = generateTile(baseX + x, baseY + y);
+        }
+    }
+}
@@ -0,0 +1,252 @@
+#include "MultiplayerSystems.h"
+#include <algorithm>
+#include <cstdlib>
+
+const unsigned char UNCLAIMED_DISTANCE = 255;
+
+TerritoryMap::TerritoryMap(int radius)
+    : tiles(0), seats(0), claimRadius(radius), chunksX(0), chunksY(0) {
+    if (claimRadius > 100) claimRadius = 100;  // Distances are stored in a byte
+    for (int i = 0; i < MAX_KINGDOMS; i++) {
+        territorySize[i] = 0;
+        borderLength[i] = 0;
+        statsDirty[i] = false;
+        for (int j = 0; j < MAX_KINGDOMS; j++) {
+            adjacent[i][j] = false;
+        }
+    }
+}
+
+TerritoryMap::~TerritoryMap() {
+    clear();
+}
+
+// Forgets every claim and matches the map's current size
+void TerritoryMap::attach(const TileMap* map, const SpatialIndex* seatIndex) {
+    clear();
+    tiles = map;
+    seats = seatIndex;
+    chunksX = (map->getWidth() + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    chunksY = (map->getHeight() + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    chunkTable.assign(chunksX * chunksY, 0);
+}
+
+void TerritoryMap::clear() {
+    for (size_t i = 0; i < chunkTable.size(); i++) {
+        delete chunkTable[i];
+    }
+    chunkTable.assign(chunkTable.size(), 0);
+    for (int i = 0; i < MAX_KINGDOMS; i++) {
+        territorySize[i] = 0;
+        borderLength[i] = 0;
+        statsDirty[i] = false;
+        for (int j = 0; j < MAX_KINGDOMS; j++) {
+            adjacent[i][j] = false;
+        }
+    }
+}
+
+// Any land can be claimed; the sea cannot
+bool TerritoryMap::claimable(int x, int y) const {
+    return tiles->inBounds(x, y) && TERRAIN_INFO[tiles->getTile(x, y).terrain].moveCost > 0;
+}
+
+void TerritoryMap::setClaim(int x, int y, int owner, int distance) {
+    TerritoryChunk*& chunk = chunkTable[(y / MAP_CHUNK_SIZE) * chunksX + x / MAP_CHUNK_SIZE];
+    if (chunk == 0) {
+        if (owner == -1) {
+            return;
+        }
+        chunk = new TerritoryChunk();
+        for (int i = 0; i < MAP_CHUNK_SIZE * MAP_CHUNK_SIZE; i++) {
+            chunk->owners[i] = -1;
+            chunk->distances[i] = UNCLAIMED_DISTANCE;
+        }
+    }
+    int slot = (y % MAP_CHUNK_SIZE) * MAP_CHUNK_SIZE + x % MAP_CHUNK_SIZE;
+    int previous = chunk->owners[slot];
+    if (previous == owner) {
+        chunk->distances[slot] = (unsigned char)distance;
+        return;
+    }
+    if (previous >= 0 && previous < MAX_KINGDOMS) territorySize[previous]--;
+    if (owner >= 0 && owner < MAX_KINGDOMS) territorySize[owner]++;
+    chunk->owners[slot] = (short)owner;
+    chunk->distances[slot] = (unsigned char)distance;
+}
+
+// Redoes the claims on every tile within claimRadius of (x,y)
+void TerritoryMap::rebuildAround(int x, int y) {
+    rebuildWithin(x, y, claimRadius);
+}
+
+// Redoes the claims on every tile within extent of (x,y). Only seats within
+// extent + claimRadius can reach those tiles, and their searches stay inside
+// a window extent + 2 * claimRadius around (x,y), so the cost does not
+// depend on the map size or the number of kingdoms
+void TerritoryMap::rebuildWithin(int x, int y, int extent) {
+    if (!tiles || !seats) {
+        return;
+    }
+    int radius = claimRadius;
+    int half = extent + 2 * radius;
+    int span = 2 * half + 1;
+    int originX = x - half;
+    int originY = y - half;
+    scratchOwners.assign(span * span, -1);
+    scratchDistances.assign(span * span, UNCLAIMED_DISTANCE);
+    frontier.clear();
+
+    // Seeding in index order makes the lower index win ties
+    vector<int> seeds;
+    seats->findWithin(x, y, extent + radius, seeds);
+    sort(seeds.begin(), seeds.end());
+    for (size_t i = 0; i < seeds.size(); i++) {
+        MapPosition seat = seats->getPosition(seeds[i]);
+        int cell = (seat.y - originY) * span + (seat.x - originX);
+        if (claimable(seat.x, seat.y) && scratchOwners[cell] == -1) {
+            scratchOwners[cell] = (short)seeds[i];
+            scratchDistances[cell] = 0;
+            frontier.push_back(cell);
+        }
+    }
+
+    const int stepX[4] = { 1, -1, 0, 0 };
+    const int stepY[4] = { 0, 0, 1, -1 };
+    for (size_t head = 0; head < frontier.size(); head++) {
+        int cell = frontier[head];
+        int distance = scratchDistances[cell];
+        if (distance == radius) {
+            continue;
+        }
+        int cellX = cell % span;
+        int cellY = cell / span;
+        for (int d = 0; d < 4; d++) {
+            int nx = cellX + stepX[d];
+            int ny = cellY + stepY[d];
+            if (nx < 0 || ny < 0 || nx >= span || ny >= span) continue;
+            int next = ny * span + nx;
+            if (scratchOwners[next] != -1 || !claimable(originX + nx, originY + ny)) continue;
+            scratchOwners[next] = scratchOwners[cell];
+            scratchDistances[next] = (unsigned char)(distance + 1);
+            frontier.push_back(next);
+        }
+    }
+
+    for (int dy = -extent; dy <= extent; dy++) {
+        int reach = extent - abs(dy);
+        for (int dx = -reach; dx <= reach; dx++) {
+            if (!tiles->inBounds(x + dx, y + dy)) continue;
+            int cell = (dy + half) * span + (dx + half);
+            setClaim(x + dx, y + dy, scratchOwners[cell], scratchDistances[cell]);
+        }
+    }
+
+    // Borders can change for any kingdom whose land touches the redone tiles
+    seats->findWithin(x, y, extent + radius + 1, seeds);
+    for (size_t i = 0; i < seeds.size(); i++) {
+        if (seeds[i] < MAX_KINGDOMS) statsDirty[seeds[i]] = true;
+    }
+}
+
+// Every claimed tile lies within claimRadius of some seat, so redoing the
+// area around each seat covers the whole map
+void TerritoryMap::rebuildAll() {
+    if (!tiles || !seats) {
+        return;
+    }
+    attach(tiles, seats);
+    for (int id = 0; id < seats->getIdLimit(); id++) {
+        MapPosition seat = seats->getPosition(id);
+        if (seat.x != -1) {
+            rebuildAround(seat.x, seat.y);
+        }
+    }
+}
+
+int TerritoryMap::getOwner(int x, int y) const {
+    if (!tiles || !tiles->inBounds(x, y)) {
+        return -1;
+    }
+    const TerritoryChunk* chunk = chunkTable[(y / MAP_CHUNK_SIZE) * chunksX + x / MAP_CHUNK_SIZE];
+    return chunk ? chunk->owners[(y % MAP_CHUNK_SIZE) * MAP_CHUNK_SIZE + x % MAP_CHUNK_SIZE] : -1;
+}
+
+// Steps from the owner's seat, or -1 for unclaimed tiles
+int TerritoryMap::getDistance(int x, int y) const {
+    if (getOwner(x, y) == -1) {
+        return -1;
+    }
+    const TerritoryChunk* chunk = chunkTable[(y / MAP_CHUNK_SIZE) * chunksX + x / MAP_CHUNK_SIZE];
+    return chunk->distances[(y % MAP_CHUNK_SIZE) * MAP_CHUNK_SIZE + x % MAP_CHUNK_SIZE];
+}
+
+// A claimed tile next to a tile held by someone else or by nobody
+bool TerritoryMap::isBorder(int x, int y) const {
+    int owner = getOwner(x, y);
+    if (owner == -1) {
+        return false;
+    }
+    return (tiles->inBounds(x + 1, y) && getOwner(x + 1, y) != owner) ||
+           (tiles->inBounds(x - 1, y) && getOwner(x - 1, y) != owner) ||
+           (tiles->inBounds(x, y + 1) && getOwner(x, y + 1) != owner) ||
+           (tiles->inBounds(x, y - 1) && getOwner(x, y - 1) != owner);
+}
+
+// Recounts one kingdom's border edges and neighbours by scanning the
+// square its claims can reach
+void TerritoryMap::refreshStats(int kingdom) const {
+    borderLength[kingdom] = 0;
+    for (int other = 0; other < MAX_KINGDOMS; other++) {
+        adjacent[kingdom][other] = false;
+        adjacent[other][kingdom] = false;
+    }
+    MapPosition seat = seats->getPosition(kingdom);
+    if (seat.x != -1) {
+        const int stepX[4] = { 1, -1, 0, 0 };
+        const int stepY[4] = { 0, 0, 1, -1 };
+        for (int y = seat.y - claimRadius; y <= seat.y + claimRadius; y++) {
+            for (int x = seat.x - claimRadius; x <= seat.x + claimRadius; x++) {
+                if (getOwner(x, y) != kingdom) continue;
+                for (int d = 0; d < 4; d++) {
+                    if (!tiles->inBounds(x + stepX[d], y + stepY[d])) continue;
+                    int other = getOwner(x + stepX[d], y + stepY[d]);
+                    if (other == kingdom) continue;
+                    borderLength[kingdom]++;
+                    if (other >= 0 && other < MAX_KINGDOMS) {
+                        adjacent[kingdom][other] = true;
+                        adjacent[other][kingdom] = true;
+                    }
+                }
+            }
+        }
+    }
+    statsDirty[kingdom] = false;
+}
+
+int TerritoryMap::getSize(int kingdom) const {
+    if (kingdom < 0 || kingdom >= MAX_KINGDOMS) {
+        return 0;
+    }
+    return territorySize[kingdom];
+}
+
+// Edges between the kingdom's tiles and tiles it does not hold
+int TerritoryMap::getBorderLength(int kingdom) const {
+    if (kingdom < 0 || kingdom >= MAX_KINGDOMS) {
+        return 0;
+    }
+    if (statsDirty[kingdom]) {
+        refreshStats(kingdom);
+    }
+    return borderLength[kingdom];
+}
+
+bool TerritoryMap::areNeighbours(int kingdomA, int kingdomB) const {
+    if (kingdomA < 0 || kingdomA >= MAX_KINGDOMS || kingdomB < 0 || kingdomB >= MAX_KINGDOMS) {
+        return false;
+    }
+    if (statsDirty[kingdomA]) refreshStats(kingdomA);
+    if (statsDirty[kingdomB]) refreshStats(kingdomB);
+    return adjacent[kingdomA][kingdomB];
+}
@@ -0,0 +1,227 @@
+#include "MultiplayerSystems.h"
+
+const TerrainInfo TERRAIN_INFO[TERRAIN_TYPE_COUNT] = {
+    // name            symbol yield  pop  defense settle moveCost
+    { "Ocean",          '~',    0,     0,   0,    false,  0 },
+    { "Plains",         '.',    2,     0,   0,    true,   1 },
+    { "Forest",         'f',    3,   200,   5,    true,   2 },
+    { "Hills",          'h',    2,   500,  10,    true,   2 },
+    { "Mountains",      '^',    1,     0,   0,    false,  4 },
+    { "River Valley",   'r',    4,  1000,   0,    true,   1 }
+};
+
+// Chunk flags
+const unsigned char CHUNK_DIRTY = 1;    // Changed since it was generated or loaded
+const unsigned char CHUNK_ON_DISK = 2;  // A saved copy exists in its chunk file
+
+// Chunks kept in memory before cold ones are evicted (256 is about 1 MB)
+const int DEFAULT_RESIDENT_CHUNKS = 256;
+
+TileMap::TileMap(int mapWidth, int mapHeight, TerrainType fill)
+    : width(0), height(0), chunksX(0), chunksY(0), generator(0),
+      residentLimit(DEFAULT_RESIDENT_CHUNKS), chunkFilePrefix("map_chunk_"), useClock(0) {
+    resize(mapWidth, mapHeight, fill);
+}
+
+TileMap::~TileMap() {
+    clear();
+}
+
+// Sets the map size and drops every chunk without saving it
+void TileMap::resize(int mapWidth, int mapHeight, TerrainType fill) {
+    clear();
+    width = mapWidth;
+    height = mapHeight;
+    chunksX = (width + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    chunksY = (height + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    chunkTable.assign(chunksX * chunksY, 0);
+    chunkLastUsed.assign(chunksX * chunksY, 0);
+    chunkFlags.assign(chunksX * chunksY, 0);
+
+    defaultTile.terrain = (unsigned char)fill;
+    defaultTile.yield = (unsigned char)TERRAIN_INFO[fill].yield;
+    defaultTile.owner = -1;
+}
+
+void TileMap::clear() {
+    for (size_t i = 0; i < residentChunks.size(); i++) {
+        delete chunkTable[residentChunks[i]];
+        chunkTable[residentChunks[i]] = 0;
+    }
+    residentChunks.clear();
+}
+
+// Chunks written to disk are named after the prefix, so worlds with
+// different seeds never read each other's files
+void TileMap::setGenerator(const TerrainGenerator* terrainGenerator, const string& filePrefix) {
+    generator = terrainGenerator;
+    chunkFilePrefix = filePrefix;
+}
+
+void TileMap::setResidentLimit(int chunks) {
+    residentLimit = chunks < 1 ? 1 : chunks;
+    evictColdChunks(-1);
+}
+
+string TileMap::chunkFileName(int index) const {
+    return chunkFilePrefix + to_string(index) + ".dat";
+}
+
+void TileMap::markChunkOnDisk(int index) {
+    if (index >= 0 && index < (int)chunkFlags.size()) {
+        chunkFlags[index] |= CHUNK_ON_DISK;
+    }
+}
+
+// True once a chunk differs from what the generator would build
+bool TileMap::hasChanges(int index) const {
+    return (chunkFlags[index] & (CHUNK_DIRTY | CHUNK_ON_DISK)) != 0;
+}
+
+// Copies a chunk, from memory or from the cache's file, into a file of
+// its own. The cache itself is left as it was
+bool TileMap::saveChunk(int index, const string& fileName) const {
+    MapChunk stored;
+    const MapChunk* chunk = chunkTable[index];
+    if (chunk == 0) {
+        ifstream in(chunkFileName(index).c_str(), ios::binary);
+        if (!in || !in.read((char*)stored.tiles, sizeof(stored.tiles))) {
+            return false;
+        }
+        chunk = &stored;
+    }
+    ofstream out(fileName.c_str(), ios::binary);
+    out.write((const char*)chunk->tiles, sizeof(chunk->tiles));
+    return out.good();
+}
+
+// Puts back a chunk written by saveChunk. It counts as changed, so the
+// cache writes it to its own file if it is evicted
+bool TileMap::restoreChunk(int index, const string& fileName) {
+    if (index < 0 || index >= (int)chunkTable.size()) {
+        return false;
+    }
+    MapChunk stored;
+    ifstream in(fileName.c_str(), ios::binary);
+    if (!in || !in.read((char*)stored.tiles, sizeof(stored.tiles))) {
+        return false;
+    }
+    *residentChunk(index, true) = stored;
+    chunkFlags[index] |= CHUNK_DIRTY;
+    return true;
+}
+
+bool TileMap::inBounds(int x, int y) const {
+    return x >= 0 && x < width && y >= 0 && y < height;
+}
+
+int TileMap::chunkIndex(int x, int y) const {
+    return (y / MAP_CHUNK_SIZE) * chunksX + (x / MAP_CHUNK_SIZE);
+}
+
+// Returns the chunk, bringing it into memory if needed. Chunks that were
+// never saved or generated are only built when create is set, so reading
+// an untouched tile of a hand-made map allocates nothing
+MapChunk* TileMap::residentChunk(int index, bool create) const {
+    MapChunk* chunk = chunkTable[index];
+    if (chunk == 0) {
+        bool onDisk = (chunkFlags[index] & CHUNK_ON_DISK) != 0;
+        if (!create && !onDisk && generator == 0) {
+            return 0;
+        }
+
+        chunk = new MapChunk;
+        bool loaded = false;
+        if (onDisk) {
+            ifstream in(chunkFileName(index).c_str(), ios::binary);
+            loaded = in && in.read((char*)chunk->tiles, sizeof(chunk->tiles));
+        }
+        if (!loaded && generator != 0) {
+            generator->fillChunk(index % chunksX, index / chunksX, *chunk);
+        } else if (!loaded) {
+            for (int i = 0; i < MAP_CHUNK_SIZE * MAP_CHUNK_SIZE; i++) {
+                chunk->tiles[i] = defaultTile;
+            }
+        }
+
+        chunkTable[index] = chunk;
+        residentChunks.push_back(index);
+        evictColdChunks(index);
+    }
+    chunkLastUsed[index] = ++useClock;
+    return chunk;
+}
+
+// Drops a chunk from memory, saving it first if it has changes
+void TileMap::evictChunk(int index) const {
+    if (chunkFlags[index] & CHUNK_DIRTY) {
+        ofstream out(chunkFileName(index).c_str(), ios::binary);
+        if (!out) {
+            return;  // Keep it rather than lose the changes
+        }
+        out.write((const char*)chunkTable[index]->tiles, sizeof(chunkTable[index]->tiles));
+        chunkFlags[index] = (chunkFlags[index] & ~CHUNK_DIRTY) | CHUNK_ON_DISK;
+    }
+    delete chunkTable[index];
+    chunkTable[index] = 0;
+    for (size_t i = 0; i < residentChunks.size(); i++) {
+        if (residentChunks[i] == index) {
+            residentChunks[i] = residentChunks.back();
+            residentChunks.pop_back();
+            break;
+        }
+    }
+}
+
+// Evicts least recently used chunks until the cache fits its limit
+void TileMap::evictColdChunks(int keepIndex) const {
+    while ((int)residentChunks.size() > residentLimit) {
+        int coldest = -1;
+        for (size_t i = 0; i < residentChunks.size(); i++) {
+            int index = residentChunks[i];
+            if (index != keepIndex && (coldest == -1 || chunkLastUsed[index] < chunkLastUsed[coldest])) {
+                coldest = index;
+            }
+        }
+        if (coldest == -1) {
+            return;
+        }
+        size_t before = residentChunks.size();
+        evictChunk(coldest);
+        if (residentChunks.size() == before) {
+            return;
+        }
+    }
+}
+
+// Out-of-bounds tiles read as the default tile
+MapTile TileMap::getTile(int x, int y) const {
+    if (!inBounds(x, y)) {
+        return defaultTile;
+    }
+    MapChunk* chunk = residentChunk(chunkIndex(x, y), false);
+    if (chunk == 0) {
+        return defaultTile;
+    }
+    return chunk->tiles[(y % MAP_CHUNK_SIZE) * MAP_CHUNK_SIZE + (x % MAP_CHUNK_SIZE)];
+}
+
+void TileMap::setTerrain(int x, int y, TerrainType terrain) {
+    if (!inBounds(x, y)) {
+        return;
+    }
+    int index = chunkIndex(x, y);
+    MapTile& tile = residentChunk(index, true)->tiles[(y % MAP_CHUNK_SIZE) * MAP_CHUNK_SIZE + (x % MAP_CHUNK_SIZE)];
+    tile.terrain = (unsigned char)terrain;
+    tile.yield = (unsigned char)TERRAIN_INFO[terrain].yield;
+    chunkFlags[index] |= CHUNK_DIRTY;
+}
+
+void TileMap::setOwner(int x, int y, int owner) {
+    if (!inBounds(x, y)) {
+        return;
+    }
+    int index = chunkIndex(x, y);
+    residentChunk(index, true)->tiles[(y % MAP_CHUNK_SIZE) * MAP_CHUNK_SIZE + (x % MAP_CHUNK_SIZE)].owner = (short)owner;
+    chunkFlags[index] |= CHUNK_DIRTY;
+}
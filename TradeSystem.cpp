@@ -1,6 +1,7 @@
 #include "MultiplayerSystems.h"
 
 string getResourceName(const string& code) {
+    ALLOCATION_SCOPE(SUBSYSTEM_TRADE);
     if (code == "food" || code == "1" || code == "Food") return "Food";
     if (code == "wood" || code == "2" || code == "Wood") return "Wood";
     if (code == "stone" || code == "3" || code == "Stone") return "Stone";
@@ -16,38 +17,46 @@ TradeSystem::TradeSystem() : tradeCount(0) {
 void TradeSystem::offerTrade(const string& offeringKingdom, const string& receivingKingdom,
                            const string& resource1Type, int resource1Amount,
                            const string& resource2Type, int resource2Amount) {
+    ALLOCATION_SCOPE(SUBSYSTEM_TRADE);
     if (tradeCount >= MAX_TRADES) {
         cout << "Maximum number of trades reached!" << endl;
         return;
     }
 
-    trades[tradeCount].offeringKingdom = offeringKingdom;
-    trades[tradeCount].receivingKingdom = receivingKingdom;
-    trades[tradeCount].resource1Type = resource1Type;
-    trades[tradeCount].resource1Amount = resource1Amount;
-    trades[tradeCount].resource2Type = resource2Type;
-    trades[tradeCount].resource2Amount = resource2Amount;
-    trades[tradeCount].isAccepted = false;
-
-    // Log the trade offer
-    tradeLog << offeringKingdom << " offers " << resource1Amount << " " << getResourceName(resource1Type)
+    // Traced up to the prompt, which waits on the player
+    {
+        TRACE_SCOPE("TradeSystem::offerTrade");
+        trades[tradeCount].offeringKingdom = offeringKingdom;
+        trades[tradeCount].receivingKingdom = receivingKingdom;
+        trades[tradeCount].resource1Type = resource1Type;
+        trades[tradeCount].resource1Amount = resource1Amount;
+        trades[tradeCount].resource2Type = resource2Type;
+        trades[tradeCount].resource2Amount = resource2Amount;
+        trades[tradeCount].isAccepted = false;
+
+        // Log the trade offer
+        tradeLog << offeringKingdom << " offers " << resource1Amount << " " << getResourceName(resource1Type)
+                 << " in exchange for " << resource2Amount << " " << getResourceName(resource2Type)
+                 << " to " << receivingKingdom << endl;
+        tradeLog.flush();
+
+        cout << offeringKingdom << " offers " << resource1Amount << " " << getResourceName(resource1Type)
              << " in exchange for " << resource2Amount << " " << getResourceName(resource2Type)
              << " to " << receivingKingdom << endl;
-    tradeLog.flush();
-
-    cout << offeringKingdom << " offers " << resource1Amount << " " << getResourceName(resource1Type)
-         << " in exchange for " << resource2Amount << " " << getResourceName(resource2Type)
-         << " to " << receivingKingdom << endl;
+    }
     cout << "Send trade offer? (y/n): ";
 
     char response;
     cin >> response;
     if (response == 'y' || response == 'Y') {
         tradeCount++;
+        Metrics::increment(METRIC_TRADES_OFFERED);
     }
 }
 
 bool TradeSystem::acceptTrade(int tradeId) {
+    TRACE_SCOPE("TradeSystem::acceptTrade");
+    ALLOCATION_SCOPE(SUBSYSTEM_TRADE);
     if (tradeId < 0 || tradeId >= tradeCount) {
         cout << "Invalid trade ID!" << endl;
         return false;
@@ -59,6 +68,7 @@ bool TradeSystem::acceptTrade(int tradeId) {
     }
 
     trades[tradeId].isAccepted = true;
+    Metrics::increment(METRIC_TRADES_MATCHED);
 
     // Log the completed trade
     tradeLog << "Trade completed between " << trades[tradeId].offeringKingdom
@@ -84,14 +94,19 @@ bool TradeSystem::acceptTrade(int tradeId) {
     return true;
 }
 
-void TradeSystem::executeSmuggling(const string& kingdom, int goldAmount, int riskPercentage) {
+// Returns the gold that got through, or -1 if the run was called off
+int TradeSystem::executeSmuggling(const string& kingdom, int goldAmount, int riskPercentage, int routeCost) {
+    // Every two points of route cost is another patrol to slip past
+    riskPercentage += routeCost / 2;
+    if (riskPercentage > 95) riskPercentage = 95;
+
     cout << "Do you want to smuggle " << goldAmount << " gold into " << kingdom
          << " (Risk: " << riskPercentage << "%)? (y/n): ";
 
     char response;
     cin >> response;
     if (response != 'y' && response != 'Y') {
-        return;
+        return -1;
     }
 
     // Simple random chance based on risk percentage
@@ -104,6 +119,7 @@ void TradeSystem::executeSmuggling(const string& kingdom, int goldAmount, int ri
         tradeLog << "Smuggling attempt failed for " << kingdom << endl;
         tradeLog << "Gold lost: " << goldAmount << endl;
         tradeLog << "Corruption increased by 5%" << endl;
+        goldAmount = 0;
     } else {
         cout << "Smuggling successful!" << endl;
         cout << "Gold transferred: " << goldAmount << endl;
@@ -112,9 +128,12 @@ void TradeSystem::executeSmuggling(const string& kingdom, int goldAmount, int ri
         tradeLog << "Gold transferred: " << goldAmount << endl;
     }
     tradeLog.flush();
+    return goldAmount;
 }
 
 void TradeSystem::saveTradesToFile() const {
+    TRACE_SCOPE("TradeSystem::saveTradesToFile");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
     ofstream saveFile("trades_save.txt");
     if (saveFile.is_open()) {
         saveFile << tradeCount << endl;
@@ -132,6 +151,8 @@ void TradeSystem::saveTradesToFile() const {
 }
 
 void TradeSystem::loadTradesFromFile() {
+    TRACE_SCOPE("TradeSystem::loadTradesFromFile");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
     ifstream loadFile("trades_save.txt");
     if (loadFile.is_open()) {
         loadFile >> tradeCount;
@@ -0,0 +1,164 @@
+#include "MultiplayerSystems.h"
+#include <cstdlib>
+#include <cstring>
+
+VisibilityMap::VisibilityMap() : tiles(0), seats(0), territory(0), chunksX(0), chunksY(0) {
+    for (int k = 0; k < MAX_KINGDOMS; k++) {
+        sightRadius[k] = BASE_SIGHT_RADIUS;
+        dirty[k] = true;
+    }
+}
+
+VisibilityMap::~VisibilityMap() {
+    clear();
+}
+
+// Forgets what everyone saw; it is all worked out again on the next query
+void VisibilityMap::attach(const TileMap* map, const SpatialIndex* seatIndex, const TerritoryMap* claims) {
+    clear();
+    tiles = map;
+    seats = seatIndex;
+    territory = claims;
+    chunksX = (map->getWidth() + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    chunksY = (map->getHeight() + MAP_CHUNK_SIZE - 1) / MAP_CHUNK_SIZE;
+    for (int k = 0; k < MAX_KINGDOMS; k++) {
+        chunkTable[k].assign(chunksX * chunksY, 0);
+    }
+}
+
+void VisibilityMap::clear() {
+    for (int k = 0; k < MAX_KINGDOMS; k++) {
+        for (size_t i = 0; i < chunkTable[k].size(); i++) {
+            delete chunkTable[k][i];
+        }
+        chunkTable[k].assign(chunkTable[k].size(), 0);
+        touchedChunks[k].clear();
+        dirty[k] = true;
+    }
+}
+
+void VisibilityMap::setSightRadius(int kingdom, int radius) {
+    if (kingdom < 0 || kingdom >= MAX_KINGDOMS) {
+        return;
+    }
+    if (radius > MAX_SIGHT_RADIUS) radius = MAX_SIGHT_RADIUS;
+    if (radius < 0) radius = 0;
+    if (sightRadius[kingdom] != radius) {
+        sightRadius[kingdom] = radius;
+        dirty[kingdom] = true;
+    }
+}
+
+// Seats or land changed at (x,y); every kingdom whose view could reach
+// that far is redrawn on its next query
+void VisibilityMap::markDirtyAround(int x, int y, int distance) {
+    if (!seats) {
+        return;
+    }
+    vector<int> nearby;
+    seats->findWithin(x, y, distance, nearby);
+    for (size_t i = 0; i < nearby.size(); i++) {
+        if (nearby[i] < MAX_KINGDOMS) dirty[nearby[i]] = true;
+    }
+}
+
+// Sets tiles x1..x2 of row y, one masked word per chunk the run crosses
+void VisibilityMap::markSpan(int kingdom, int y, int x1, int x2) {
+    if (y < 0 || y >= tiles->getHeight()) {
+        return;
+    }
+    if (x1 < 0) x1 = 0;
+    if (x2 >= tiles->getWidth()) x2 = tiles->getWidth() - 1;
+    int chunkY = y / MAP_CHUNK_SIZE;
+    int row = y % MAP_CHUNK_SIZE;
+    while (x1 <= x2) {
+        int chunkX = x1 / MAP_CHUNK_SIZE;
+        int low = x1 % MAP_CHUNK_SIZE;
+        int high = (x2 / MAP_CHUNK_SIZE == chunkX) ? x2 % MAP_CHUNK_SIZE : MAP_CHUNK_SIZE - 1;
+        unsigned int mask = (high - low == 31) ? 0xFFFFFFFFu : ((1u << (high - low + 1)) - 1) << low;
+
+        int index = chunkY * chunksX + chunkX;
+        VisionChunk*& chunk = chunkTable[kingdom][index];
+        if (chunk == 0) {
+            chunk = new VisionChunk();
+            memset(chunk->rows, 0, sizeof(chunk->rows));
+            chunk->listed = false;
+        }
+        if (!chunk->listed) {
+            chunk->listed = true;
+            touchedChunks[kingdom].push_back(index);
+        }
+        chunk->rows[row] |= mask;
+        x1 = (chunkX + 1) * MAP_CHUNK_SIZE;
+    }
+}
+
+// Clears only the chunks this kingdom saw before, then draws its sight
+// diamond and its territory back in
+void VisibilityMap::refresh(int kingdom) {
+    for (size_t i = 0; i < touchedChunks[kingdom].size(); i++) {
+        VisionChunk* chunk = chunkTable[kingdom][touchedChunks[kingdom][i]];
+        memset(chunk->rows, 0, sizeof(chunk->rows));
+        chunk->listed = false;
+    }
+    touchedChunks[kingdom].clear();
+    dirty[kingdom] = false;
+
+    MapPosition seat = seats->getPosition(kingdom);
+    if (seat.x == -1) {
+        return;
+    }
+    int sight = sightRadius[kingdom];
+    for (int dy = -sight; dy <= sight; dy++) {
+        int reach = sight - abs(dy);
+        markSpan(kingdom, seat.y + dy, seat.x - reach, seat.x + reach);
+    }
+
+    // Territory comes in as runs of owned tiles along each row
+    int claim = territory->getClaimRadius();
+    for (int y = seat.y - claim; y <= seat.y + claim; y++) {
+        int runStart = -1;
+        for (int x = seat.x - claim; x <= seat.x + claim + 1; x++) {
+            bool owned = x <= seat.x + claim && territory->getOwner(x, y) == kingdom;
+            if (owned && runStart == -1) {
+                runStart = x;
+            } else if (!owned && runStart != -1) {
+                markSpan(kingdom, y, runStart, x - 1);
+                runStart = -1;
+            }
+        }
+    }
+}
+
+bool VisibilityMap::canSee(int kingdom, int x, int y) {
+    if (kingdom < 0 || kingdom >= MAX_KINGDOMS || !tiles || !tiles->inBounds(x, y)) {
+        return false;
+    }
+    if (dirty[kingdom]) {
+        refresh(kingdom);
+    }
+    const VisionChunk* chunk = chunkTable[kingdom][(y / MAP_CHUNK_SIZE) * chunksX + x / MAP_CHUNK_SIZE];
+    return chunk && ((chunk->rows[y % MAP_CHUNK_SIZE] >> (x % MAP_CHUNK_SIZE)) & 1u);
+}
+
+// Number of tiles the kingdom can see, a word at a time
+int VisibilityMap::countVisible(int kingdom) {
+    if (kingdom < 0 || kingdom >= MAX_KINGDOMS || !tiles) {
+        return 0;
+    }
+    if (dirty[kingdom]) {
+        refresh(kingdom);
+    }
+    int total = 0;
+    for (size_t i = 0; i < touchedChunks[kingdom].size(); i++) {
+        const VisionChunk* chunk = chunkTable[kingdom][touchedChunks[kingdom][i]];
+        for (int r = 0; r < MAP_CHUNK_SIZE; r++) {
+            unsigned int word = chunk->rows[r];
+            while (word) {
+                word &= word - 1;
+                total++;
+            }
+        }
+    }
+    return total;
+}
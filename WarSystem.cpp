@@ -38,7 +38,8 @@ Army& WarSystem::getKingdomArmy(const string& kingdomName) {
     return kingdomArmies[index];
 }
 
-void WarSystem::declareWar(const string& attacker, const string& defender, Army& attackerArmy) {
+void WarSystem::declareWar(const string& attacker, const string& defender, Army& attackerArmy, int marchTurns) {
+    ALLOCATION_SCOPE(SUBSYSTEM_WAR);
     int defenderIndex = getKingdomIndex(defender);
     if (defenderIndex == -1) {
         cout << "Target kingdom not found!" << endl;
@@ -52,17 +53,25 @@ void WarSystem::declareWar(const string& attacker, const string& defender, Army&
     if (response != 'y' && response != 'Y') {
         return;
     }
+    TRACE_SCOPE("WarSystem::declareWar");  // Traced after the prompt
 
     // Log war declaration
     warLog << attacker << " has declared war on " << defender << endl;
     warLog.flush();
 
     cout << "You have declared war on " << defender << endl;
-    cout << "Army morale: +10%" << endl;
+    if (marchTurns > 0) {
+        cout << "The march to " << defender << " takes " << marchTurns << " turn(s)" << endl;
+    }
+    // Long marches wear the army down before it gets there
+    int moraleGain = 10 - 2 * marchTurns;
+    if (moraleGain < -10) moraleGain = -10;
+    cout << "Army morale: " << (moraleGain >= 0 ? "+" : "") << moraleGain << "%" << endl;
     cout << "Public support: -5%" << endl;
 
     // Update attacker's army morale
-    attackerArmy.setMorale(attackerArmy.getMorale() + 10);
+    attackerArmy.setMorale(attackerArmy.getMorale() + moraleGain);
+    if (attackerArmy.getMorale() < 0) attackerArmy.setMorale(0);
     if (attackerArmy.getMorale() > 100) attackerArmy.setMorale(100);
 
     // Update defender's army morale
@@ -71,9 +80,10 @@ void WarSystem::declareWar(const string& attacker, const string& defender, Army&
         kingdomArmies[defenderIndex].setMorale(0);
 }
 
-int WarSystem::calculateBattleOutcome(const Army& attacker, const Army& defender) {
-    // Simple battle calculation based on army size and morale
-    int attackerStrength = attacker.getSoldierCount() * (attacker.getMorale() / 100.0);
+int WarSystem::calculateBattleOutcome(const Army& attacker, const Army& defender, int marchTurns) {
+    // Simple battle calculation based on army size and morale; every turn
+    // on the march costs the attacker 5% of its strength
+    int attackerStrength = attacker.getSoldierCount() * (attacker.getMorale() / 100.0) / (1.0 + 0.05 * marchTurns);
     int defenderStrength = defender.getSoldierCount() * (defender.getMorale() / 100.0);
 
     // Add some randomness
@@ -112,7 +122,9 @@ void WarSystem::applyBattleConsequences(Army& winner, Army& loser,
 }
 
 void WarSystem::simulateBattle(const string& attacker, const string& defender,
-                              ResourceManager& attackerRes, ResourceManager& defenderRes) {
+                              ResourceManager& attackerRes, ResourceManager& defenderRes, int marchTurns) {
+    TRACE_SCOPE("WarSystem::simulateBattle");
+    ALLOCATION_SCOPE(SUBSYSTEM_WAR);
     int attackerIndex = getKingdomIndex(attacker);
     int defenderIndex = getKingdomIndex(defender);
 
@@ -125,7 +137,8 @@ void WarSystem::simulateBattle(const string& attacker, const string& defender,
     cout << "Battle between " << attacker << " and " << defender << "..." << endl;
 
     int battleOutcome = calculateBattleOutcome(kingdomArmies[attackerIndex], 
-                                             kingdomArmies[defenderIndex]);
+                                             kingdomArmies[defenderIndex], marchTurns);
+    Metrics::increment(METRIC_BATTLES);
 
     if (battleOutcome > 0) {
         cout << attacker << " wins!" << endl;
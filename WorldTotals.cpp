@@ -0,0 +1,21 @@
+#include "MultiplayerSystems.h"
+
+WorldTotals::WorldTotals(const KingdomData* kingdomList, const int* count)
+    : kingdoms(kingdomList), kingdomCount(count), dirty(true) {
+    for (int r = 0; r < RANKED_RESOURCE_COUNT; r++) {
+        totals[r] = 0;
+    }
+}
+
+long long WorldTotals::get(int resource) {
+    if (dirty) {
+        for (int r = 0; r < RANKED_RESOURCE_COUNT; r++) {
+            totals[r] = 0;
+            for (int i = 0; i < *kingdomCount; i++) {
+                totals[r] += KingdomLeaderboards::valueOf(r, kingdoms[i].resources);
+            }
+        }
+        dirty = false;
+    }
+    return totals[resource];
+}
@@ -0,0 +1,165 @@
+#include "Stronghold.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Per-subsystem counters. They only ever hold plain numbers, so they are
+// ready before any constructor runs and still valid after destructors
+struct SubsystemCounters {
+    atomic<unsigned long long> allocations;
+    atomic<unsigned long long> bytes;
+    atomic<long long> liveBytes;
+    atomic<long long> peakLiveBytes;
+};
+
+static SubsystemCounters counters[SUBSYSTEM_COUNT];
+static atomic<long long> totalLiveBytes(0);
+static atomic<long long> totalPeakLiveBytes(0);
+static thread_local int currentSubsystem = SUBSYSTEM_OTHER;
+
+// Allocations at the last turn boundary, to work out each turn's share
+static unsigned long long turnStart[SUBSYSTEM_COUNT];
+static unsigned long long lastTurn[SUBSYSTEM_COUNT];
+static unsigned long long busiestTurn[SUBSYSTEM_COUNT];
+static int turnsCounted = 0;
+
+bool AllocationStats::reportTurns = false;
+
+static const char* SUBSYSTEM_NAMES[SUBSYSTEM_COUNT] = {
+    "Other", "Population", "Army", "Economy", "Resources", "Events", "Kingdoms",
+    "War", "Trade", "Alliances", "Messages", "Map", "Epidemic", "Save/Load"
+};
+
+static void raisePeak(atomic<long long>& peak, long long value) {
+    long long seen = peak.load(memory_order_relaxed);
+    while (value > seen && !peak.compare_exchange_weak(seen, value, memory_order_relaxed)) {
+    }
+}
+
+int AllocationStats::enter(int subsystem) {
+    int previous = currentSubsystem;
+    currentSubsystem = subsystem;
+    return previous;
+}
+
+void AllocationStats::leave(int previous) {
+    currentSubsystem = previous;
+}
+
+void AllocationStats::charge(int subsystem, size_t bytes) {
+    SubsystemCounters& c = counters[subsystem];
+    c.allocations.fetch_add(1, memory_order_relaxed);
+    c.bytes.fetch_add(bytes, memory_order_relaxed);
+    raisePeak(c.peakLiveBytes, c.liveBytes.fetch_add(bytes, memory_order_relaxed) + (long long)bytes);
+    raisePeak(totalPeakLiveBytes, totalLiveBytes.fetch_add(bytes, memory_order_relaxed) + (long long)bytes);
+}
+
+void AllocationStats::release(int subsystem, size_t bytes) {
+    counters[subsystem].liveBytes.fetch_sub(bytes, memory_order_relaxed);
+    totalLiveBytes.fetch_sub(bytes, memory_order_relaxed);
+}
+
+unsigned long long AllocationStats::getAllocations() {
+    unsigned long long total = 0;
+    for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+        total += counters[i].allocations.load(memory_order_relaxed);
+    }
+    return total;
+}
+
+unsigned long long AllocationStats::getAllocations(int subsystem) {
+    return counters[subsystem].allocations.load(memory_order_relaxed);
+}
+
+long long AllocationStats::getLiveBytes() {
+    return totalLiveBytes.load(memory_order_relaxed);
+}
+
+long long AllocationStats::getPeakLiveBytes() {
+    return totalPeakLiveBytes.load(memory_order_relaxed);
+}
+
+const char* AllocationStats::subsystemName(int subsystem) {
+    return subsystem >= 0 && subsystem < SUBSYSTEM_COUNT ? SUBSYSTEM_NAMES[subsystem] : "?";
+}
+
+// Closes the current turn's tally; with --alloc-stats it is printed too
+void AllocationStats::endTurn() {
+    unsigned long long turnTotal = 0;
+    for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+        unsigned long long now = counters[i].allocations.load(memory_order_relaxed);
+        lastTurn[i] = now - turnStart[i];
+        turnStart[i] = now;
+        if (lastTurn[i] > busiestTurn[i]) busiestTurn[i] = lastTurn[i];
+        turnTotal += lastTurn[i];
+    }
+    turnsCounted++;
+
+    if (reportTurns) {
+        cout << "[alloc] turn " << turnsCounted << ": " << turnTotal << " allocations, "
+             << getLiveBytes() << " bytes live, peak " << getPeakLiveBytes() << "\n";
+    }
+}
+
+void AllocationStats::report(ostream& out) {
+    char line[160];
+    out << "\n=== Heap Allocations by Subsystem ===\n";
+    snprintf(line, sizeof(line), "%-11s %12s %10s %10s %10s %14s %12s %12s\n",
+             "Subsystem", "Allocations", "Per turn", "Last turn", "Max turn", "Bytes", "Live bytes", "Peak live");
+    out << line;
+    for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+        const SubsystemCounters& c = counters[i];
+        unsigned long long allocations = c.allocations.load(memory_order_relaxed);
+        if (allocations == 0) {
+            continue;
+        }
+        snprintf(line, sizeof(line), "%-11s %12llu %10.1f %10llu %10llu %14llu %12lld %12lld\n",
+                 SUBSYSTEM_NAMES[i], allocations,
+                 turnsCounted > 0 ? (double)turnStart[i] / turnsCounted : 0.0,
+                 lastTurn[i], busiestTurn[i], c.bytes.load(memory_order_relaxed),
+                 c.liveBytes.load(memory_order_relaxed), c.peakLiveBytes.load(memory_order_relaxed));
+        out << line;
+    }
+    out << "Turns: " << turnsCounted << ", live bytes: " << getLiveBytes()
+        << ", peak live bytes: " << getPeakLiveBytes() << "\n";
+}
+
+#ifndef STRONGHOLD_NO_ALLOC_TRACKING
+
+// Every block carries who allocated it and how big it is, in a header
+// that keeps the caller's pointer aligned for any type
+struct AllocationHeader {
+    size_t size;
+    int subsystem;
+};
+
+const size_t ALLOCATION_HEADER_SIZE = 16;
+
+void* operator new(size_t size) {
+    char* block = (char*)malloc(size + ALLOCATION_HEADER_SIZE);
+    if (!block) {
+        throw bad_alloc();
+    }
+    AllocationHeader* header = (AllocationHeader*)block;
+    header->size = size;
+    header->subsystem = currentSubsystem;
+    AllocationStats::charge(currentSubsystem, size);
+    return block + ALLOCATION_HEADER_SIZE;
+}
+
+void operator delete(void* pointer) noexcept {
+    if (!pointer) {
+        return;
+    }
+    char* block = (char*)pointer - ALLOCATION_HEADER_SIZE;
+    AllocationHeader* header = (AllocationHeader*)block;
+    AllocationStats::release(header->subsystem, header->size);
+    free(block);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+#endif // STRONGHOLD_NO_ALLOC_TRACKING
@@ -19,7 +19,7 @@ void Army::recruitAndTrain(Population& pop) {
 
     cout << "Current Army Size: " << soldierCount << "\n";
     cout << "Current Morale: " << troopMorale << "%\n";
-    cout << "Maximum possible recruits: " << (pop.getTotal() * 0.2 - soldierCount) << "\n";
+    cout << "Maximum possible recruits: " << (pop.getRecruitableCount() - soldierCount) << "\n";
     
     cout << "How many soldiers would you like to recruit? (0 to cancel): ";
     int newRecruits;
@@ -30,9 +30,9 @@ void Army::recruitAndTrain(Population& pop) {
         return;
     }
     
-    if (newRecruits + soldierCount > pop.getTotal() * 0.2) {
+    if (newRecruits + soldierCount > pop.getRecruitableCount()) {
         cout << "Warning: That would make the army too large for the population!\n";
-        cout << "Maximum allowed recruits: " << (pop.getTotal() * 0.2 - soldierCount) << "\n";
+        cout << "Maximum allowed recruits: " << (pop.getRecruitableCount() - soldierCount) << "\n";
         return;
     }
     
@@ -51,7 +51,7 @@ void Army::recruitAndTrain(Population& pop) {
         soldierCount += newRecruits;
         troopMorale += 5; // Training boosts morale
         
-        if (soldierCount > pop.getTotal() * 0.2) {
+        if (soldierCount > pop.getRecruitableCount()) {
             cout << "Warning: Army size is too large for population!\n";
             troopMorale -= 10;
         }
@@ -68,13 +68,15 @@ void Army::recruitAndTrain(Population& pop) {
 
 // Shows current army stats
 void Army::showStats() const {
-    cout << "\n==================================================\n";
-    cout << "                     MILITARY OVERVIEW                     \n";
-    cout << "==================================================\n";
-    cout << "Active Forces: " << soldierCount << " soldiers\n";
-    cout << "Troop Morale: " << troopMorale << "%\n";
-    cout << "Military Rations: " << militaryRations << " units\n";
-    cout << "==================================================\n";
+    ScreenBuffer& screen = ScreenBuffer::console();
+    screen << "\n==================================================\n";
+    screen << "                     MILITARY OVERVIEW                     \n";
+    screen << "==================================================\n";
+    screen << "Active Forces: " << soldierCount << " soldiers\n";
+    screen << "Troop Morale: " << troopMorale << "%\n";
+    screen << "Military Rations: " << militaryRations << " units\n";
+    screen << "==================================================\n";
+    screen.present();
 }
 
 // Saves army data to a file
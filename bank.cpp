@@ -3,6 +3,21 @@
 Bank::Bank() {
     activeLoans = 0;
     detectedFraud = 0;
+    limitDirty = true;
+    limitTreasury = 0;
+    safeLoanLimit = 0;
+}
+
+// How much more can be borrowed while loans stay within half the treasury.
+// Kept until the loans or the treasury change
+double Bank::getSafeLoanLimit(const Economy& economy) const {
+    int treasury = economy.getTreasury();
+    if (limitDirty || treasury != limitTreasury) {
+        safeLoanLimit = treasury * 0.5 - activeLoans;
+        limitTreasury = treasury;
+        limitDirty = false;
+    }
+    return safeLoanLimit;
 }
 
 // Checks the treasury 
@@ -17,7 +32,7 @@ void Bank::auditTreasury(Economy& economy) {
         detectedFraud += 5;
     }
     
-    if (activeLoans > treasury * 0.5) {
+    if (getSafeLoanLimit(economy) < 0) {
         cout << "Warning: Too many active loans!\n";
         detectedFraud += 3;
     }
@@ -42,9 +57,9 @@ void Bank::issueLoan(Economy& economy, int amount) {
     cout << "Current Active Loans: " << activeLoans << " gold\n";
     cout << "Proposed Loan Amount: " << amount << " gold\n";
     
-    if (activeLoans + amount > economy.getTreasury() * 0.5) {
+    if (amount > getSafeLoanLimit(economy)) {
         cout << "Warning: This loan would exceed the safe limit!\n";
-        cout << "Maximum safe loan amount: " << (economy.getTreasury() * 0.5 - activeLoans) << " gold\n";
+        cout << "Maximum safe loan amount: " << getSafeLoanLimit(economy) << " gold\n";
         cout << "Proceed anyway? (y/n): ";
         char proceed;
         cin >> proceed;
@@ -55,6 +70,7 @@ void Bank::issueLoan(Economy& economy, int amount) {
     }
     
     activeLoans += amount;
+    limitDirty = true;
     economy.receiveLoan(amount);
     cout << "Loan of " << amount << " gold issued successfully.\n";
     cout << "New Active Loans: " << activeLoans << " gold\n";
@@ -87,6 +103,7 @@ void Bank::repayLoan(Economy& economy, int amount) {
     
     if (confirm == 'y' || confirm == 'Y') {
         activeLoans -= amount;
+        limitDirty = true;
         economy.spend(amount);
         cout << "Repaid " << amount << " gold of the loan.\n";
         cout << "Remaining Loans: " << activeLoans << " gold\n";
@@ -99,12 +116,14 @@ void Bank::repayLoan(Economy& economy, int amount) {
 
 // Shows current bank stats
 void Bank::showStats() const {
-    cout << "\n==================================================\n";
-    cout << "                    BANK OVERVIEW                  \n";
-    cout << "==================================================\n";
-    cout << "Active Loans: " << activeLoans << " gold\n";
-    cout << "Detected Fraud: " << detectedFraud << " points\n";
-    cout << "==================================================\n";
+    ScreenBuffer& screen = ScreenBuffer::console();
+    screen << "\n==================================================\n";
+    screen << "                    BANK OVERVIEW                  \n";
+    screen << "==================================================\n";
+    screen << "Active Loans: " << activeLoans << " gold\n";
+    screen << "Detected Fraud: " << detectedFraud << " points\n";
+    screen << "==================================================\n";
+    screen.present();
 }
 
 // Saves bank data to a file
@@ -130,6 +149,7 @@ void Bank::loadFromFile() {
     }
     
     in >> activeLoans >> detectedFraud;
+    limitDirty = true;
     in.close();
     cout << "Bank records restored successfully.\n";
 }
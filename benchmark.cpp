@@ -0,0 +1,780 @@
+// Benchmarks for every subsystem of the game. The file only builds when
+// STRONGHOLD_BENCHMARK is defined, which also drops the game's own main:
+//
+//   g++ -std=c++17 -O2 -DSTRONGHOLD_BENCHMARK *.cpp -o benchmark
+//   ./benchmark [--quick] [--perf] [--trace file] [name prefix ...]
+//   ./benchmark --check
+//
+// Run it from a scratch directory, the save and log files of the game are
+// written where it runs. Every benchmark is timed at each point of one
+// scaling parameter (kingdoms, map size or history length) with the other
+// two at their defaults, and reports ns/op, allocations/op and how much
+// slower each point is than the first one. Allocations are counted by the
+// game's own heap accounting, so a build with STRONGHOLD_NO_ALLOC_TRACKING
+// reports none. On Linux --perf also reads the CPU's cycle, instruction,
+// cache miss and branch miss counters over the timed code and adds IPC and
+// misses per op. --check runs the consistency checks instead and exits
+// with 1 if any of them fails
+//
+// The kingdom axis only goes from 2 to MAX_KINGDOMS, which is 4, so its
+// growth column shows little more than per-kingdom cost. It cannot tell
+// linear from quadratic work; the map and history axes can
+#ifdef STRONGHOLD_BENCHMARK
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include "Stronghold.h"
+#include "MultiplayerSystems.h"
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Game state and helpers that live in main.cpp
+extern KingdomData kingdoms[MAX_KINGDOMS];
+extern int kingdomCount;
+extern int activeKingdomIndex;
+extern bool alliances[MAX_KINGDOMS][MAX_KINGDOMS];
+extern bool wars[MAX_KINGDOMS][MAX_KINGDOMS];
+int calculateBattleOutcome(const KingdomData& attacker, const KingdomData& defender);
+bool evaluateTradeOffer(const KingdomData& offering, const KingdomData& receiving,
+                       int offerGold, int offerArmy, int reqGold, int reqArmy, int routeCost);
+bool isTradeFavorable(const KingdomResources& offering, const KingdomResources& requesting, const KingdomResources& kingdom,
+                      int routeCost);
+void updateMapLayers(MapSystem& map);
+void kingdomChanged(int kingdom);
+void advanceTurn(MapSystem& map, EpidemicSystem& epidemic, EventManager& events);
+void saveGameState(const Population& pop, const Army& army, const Economy& eco,
+                  const ResourceManager& res, const Bank& bank,
+                  const CommunicationSystem& comm, const AllianceSystem& alliance,
+                  const TradeSystem& trade, const MapSystem& map);
+void loadGameState(Population& pop, Army& army, Economy& eco,
+                  ResourceManager& res, Bank& bank,
+                  CommunicationSystem& comm, AllianceSystem& alliance,
+                  TradeSystem& trade, MapSystem& map);
+
+// Hardware counters read as one group, so they all cover the same code.
+// Only user-space work is counted, which ordinary users may measure
+enum PerfCounter { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_BRANCH_MISSES, PERF_COUNTER_COUNT };
+
+struct PerfValues {
+    double counts[PERF_COUNTER_COUNT];
+};
+
+static int perfFds[PERF_COUNTER_COUNT] = { -1, -1, -1, -1 };
+static bool perfActive = false;
+
+#ifdef __linux__
+static int openPerfCounter(unsigned long long config, int groupFd) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = groupFd == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+static void closePerfCounters() {
+#ifdef __linux__
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (perfFds[i] != -1) close(perfFds[i]);
+        perfFds[i] = -1;
+    }
+#endif
+    perfActive = false;
+}
+
+// Fails on other systems and where the kernel or a container forbids it
+static bool openPerfCounters() {
+#ifdef __linux__
+    static const unsigned long long configs[PERF_COUNTER_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        perfFds[i] = openPerfCounter(configs[i], i == 0 ? -1 : perfFds[0]);
+        if (perfFds[i] == -1) {
+            closePerfCounters();
+            return false;
+        }
+    }
+    perfActive = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void perfControl(int request) {
+#ifdef __linux__
+    if (perfActive) {
+        ioctl(perfFds[0], request, PERF_IOC_FLAG_GROUP);
+    }
+#else
+    (void)request;
+#endif
+}
+
+// Scaled up when the kernel had to share the counters with other users
+static PerfValues readPerfCounters() {
+    PerfValues values;
+    memset(&values, 0, sizeof(values));
+#ifdef __linux__
+    unsigned long long data[3 + PERF_COUNTER_COUNT];
+    if (perfActive && read(perfFds[0], data, sizeof(data)) == (ssize_t)sizeof(data) && data[2] > 0) {
+        double scale = (double)data[1] / data[2];
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+            values.counts[i] = data[3 + i] * scale;
+        }
+    }
+#endif
+    return values;
+}
+
+// Timer that setup work inside a benchmark can step out of. The hardware
+// counters stop and start with it
+static chrono::steady_clock::time_point timerStart;
+static long long timerElapsed = 0;
+static unsigned long long pausedAllocations = 0;
+static unsigned long long pauseAllocationMark = 0;
+
+static void resumeTiming() {
+    pausedAllocations += AllocationStats::getAllocations() - pauseAllocationMark;
+#ifdef __linux__
+    perfControl(PERF_EVENT_IOC_ENABLE);
+#endif
+    timerStart = chrono::steady_clock::now();
+}
+
+static void pauseTiming() {
+    timerElapsed += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - timerStart).count();
+#ifdef __linux__
+    perfControl(PERF_EVENT_IOC_DISABLE);
+#endif
+    pauseAllocationMark = AllocationStats::getAllocations();
+}
+
+// Swallows the menus and reports the systems print while they are timed
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) { return c; }
+    streamsize xsputn(const char*, streamsize n) { return n; }
+};
+
+static NullBuffer nullBuffer;
+static streambuf* realOutput = 0;
+
+static void muteOutput() {
+    realOutput = cout.rdbuf(&nullBuffer);
+}
+
+static void restoreOutput() {
+    cout.rdbuf(realOutput);
+}
+
+enum BenchAxis { AXIS_KINGDOMS, AXIS_MAP, AXIS_HISTORY };
+
+struct BenchParams {
+    int kingdoms;
+    int mapSize;
+    int history;  // Messages, trades and alliances already on record
+};
+
+const BenchParams DEFAULT_PARAMS = { MAX_KINGDOMS, 64, 32 };
+// Bounded by the game's fixed kingdom arrays, see the note at the top
+const int KINGDOM_POINTS[] = { 2, 3, 4 };
+const int MAP_POINTS[] = { 16, 64, 256, 1024 };
+const int HISTORY_POINTS[] = { 8, 16, 32, 64 };
+
+// Room for a million individual citizens when four kingdoms are in play
+const int CITIZENS_PER_KINGDOM = 250000;
+
+// Everything a benchmark may need, rebuilt before each point
+struct BenchWorld {
+    MapSystem* map;
+    EpidemicSystem* epidemic;
+    EventManager* events;
+    WarSystem* war;
+    AllianceSystem* alliance;
+    CommunicationSystem* comm;
+    TradeSystem* trade;
+    Population* population;
+    Army* army;
+    Economy* economy;
+    ResourceManager* resources;
+    Bank* bank;
+    CitizenWorld* citizens;
+    BenchParams params;
+    int messagesSent;
+    istringstream replies;
+};
+
+static BenchWorld world;
+
+static void destroyWorld() {
+    delete world.map;
+    delete world.epidemic;
+    delete world.events;
+    delete world.war;
+    delete world.alliance;
+    delete world.comm;
+    delete world.trade;
+    delete world.population;
+    delete world.army;
+    delete world.economy;
+    delete world.resources;
+    delete world.bank;
+    delete world.citizens;
+    world.map = 0;
+    world.epidemic = 0;
+    world.events = 0;
+    world.war = 0;
+    world.alliance = 0;
+    world.comm = 0;
+    world.trade = 0;
+    world.population = 0;
+    world.army = 0;
+    world.economy = 0;
+    world.resources = 0;
+    world.bank = 0;
+    world.citizens = 0;
+}
+
+// Tries tiles around the centre of each quarter of the map until the
+// kingdom finds somewhere to settle
+static bool placeKingdom(MapSystem& map, int index, int mapSize, KingdomData& k) {
+    int centerX = mapSize * (1 + 2 * (index % 2)) / 4;
+    int centerY = mapSize * (1 + 2 * (index / 2 % 2)) / 4;
+    k.name = "Realm" + to_string(index);
+    for (int radius = 0; radius < mapSize; radius++) {
+        for (int dy = -radius; dy <= radius; dy++) {
+            for (int dx = -radius; dx <= radius; dx++) {
+                if ((abs(dx) == radius || abs(dy) == radius) && map.canSettle(centerX + dx, centerY + dy) &&
+                    map.initializeKingdom(k.name, centerX + dx, centerY + dy)) {
+                    k.x = centerX + dx;
+                    k.y = centerY + dy;
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static void buildWorld(const BenchParams& params) {
+    destroyWorld();
+    world.params = params;
+    // Every point starts on turn 0, so nothing built here has turns from
+    // earlier points to catch up on
+    GameClock::set(0);
+    world.map = new MapSystem();
+    world.map->generateWorld(params.mapSize, params.mapSize, 1234);
+    world.epidemic = new EpidemicSystem(params.mapSize, params.mapSize);
+    world.events = new EventManager();
+    world.war = new WarSystem();
+    world.alliance = new AllianceSystem();
+    world.comm = new CommunicationSystem();
+    world.trade = new TradeSystem();
+    world.population = new Population();
+    world.army = new Army();
+    world.economy = new Economy();
+    world.resources = new ResourceManager();
+    world.bank = new Bank();
+
+    srand(42);
+    kingdomCount = 0;
+    activeKingdomIndex = 0;
+    memset(alliances, 0, sizeof(alliances));
+    memset(wars, 0, sizeof(wars));
+    for (int i = 0; i < params.kingdoms; i++) {
+        KingdomData k = {};
+        if (!placeKingdom(*world.map, i, params.mapSize, k)) {
+            break;
+        }
+        k.resources.gold = 3000 + 1000 * i;
+        k.resources.food = 2000;
+        k.resources.army = 400 + 150 * i;
+        k.resources.materials = 1000;
+        k.resources.population = 3000;
+        k.resources.morale = 70 + 5 * i;
+        k.resources.happiness = 70;
+        kingdoms[kingdomCount++] = k;
+        kingdomChanged(kingdomCount - 1);
+
+        Army army;
+        army.setSoldierCount(k.resources.army);
+        army.setMorale(k.resources.morale);
+        world.war->registerKingdom(k.name, army);
+    }
+    world.events->attachEpidemic(world.epidemic, params.mapSize / 2, params.mapSize / 2);
+    world.events->scheduleKingdoms(kingdomCount);
+    updateMapLayers(*world.map);
+    if (kingdomCount > 0) {
+        world.epidemic->seedOutbreak(kingdoms[0].x, kingdoms[0].y, 0.05f);
+    }
+
+    // History: older entries first, so lookups for the real kingdoms have
+    // to get past all of it
+    int fillerAlliances = min(params.history, MAX_ALLIANCES - kingdomCount * (kingdomCount - 1) / 2);
+    for (int i = 0; i < fillerAlliances; i++) {
+        world.alliance->formAlliance("Envoy" + to_string(i), "Envoy" + to_string(i + 1));
+    }
+    for (int a = 0; a < kingdomCount; a++) {
+        for (int b = a + 1; b < kingdomCount; b++) {
+            world.alliance->formAlliance(kingdoms[a].name, kingdoms[b].name);
+            alliances[a][b] = alliances[b][a] = true;
+        }
+    }
+    for (int i = 0; i < min(params.history, MAX_MESSAGES) && kingdomCount > 1; i++) {
+        world.comm->sendMessage(kingdoms[i % kingdomCount].name, kingdoms[(i + 1) % kingdomCount].name,
+                                "Greetings", (MessageType)(i % 4));
+    }
+    world.messagesSent = min(params.history, MAX_MESSAGES);
+    for (int i = 0; i < min(params.history, MAX_TRADES) && kingdomCount > 1; i++) {
+        world.trade->offerTrade(kingdoms[i % kingdomCount].name, kingdoms[(i + 1) % kingdomCount].name,
+                                "Gold", 100 + i, "Food", 50 + i);
+    }
+}
+
+// The individual citizens of every kingdom, filled from a census of the
+// population's age and class cohorts. Only the citizen benchmarks need
+// them, so they are built on first use and outside the timer
+static CitizenWorld& citizenWorld() {
+    if (world.citizens == 0) {
+        pauseTiming();
+        int people = CITIZENS_PER_KINGDOM * 9 / 10;  // Leaves room for migrants
+        Population census;
+        census.setPeasantCount(people * 80 / 100);
+        census.setMerchantCount(people * 15 / 100);
+        census.setNobleCount(people - people * 80 / 100 - people * 15 / 100);
+        census.setTotal(people);
+        census.rebuildCohorts();
+        world.citizens = new CitizenWorld(world.params.kingdoms, CITIZENS_PER_KINGDOM);
+        for (int k = 0; k < world.params.kingdoms; k++) {
+            world.citizens->populateFrom(k, census);
+        }
+        world.citizens->assignEmployment(0.6f);
+        resumeTiming();
+    }
+    return *world.citizens;
+}
+
+// Benchmarks. Each one is handed the number of the call so it can cycle
+// through kingdoms or positions
+
+static void benchBattleKingdomData(int i) {
+    int a = i % kingdomCount;
+    int b = (a + 1 + i / kingdomCount % (kingdomCount - 1)) % kingdomCount;
+    calculateBattleOutcome(kingdoms[a], kingdoms[b]);
+}
+
+// WarSystem::calculateBattleOutcome is private, so it is timed through the
+// battle that calls it, log writes included
+static void benchBattleWarSystem(int i) {
+    int a = i % kingdomCount;
+    int b = (a + 1) % kingdomCount;
+    world.war->getKingdomArmy(kingdoms[a].name).setSoldierCount(kingdoms[a].resources.army);
+    world.war->getKingdomArmy(kingdoms[b].name).setSoldierCount(kingdoms[b].resources.army);
+    world.war->simulateBattle(kingdoms[a].name, kingdoms[b].name, *world.resources, *world.resources,
+                              world.map->getMarchTurns(a, b));
+}
+
+static void benchTradeEvaluate(int i) {
+    int a = i % kingdomCount;
+    int b = (a + 1) % kingdomCount;
+    int routeCost = world.map->getRouteCost(a, b);
+    evaluateTradeOffer(kingdoms[a], kingdoms[b], 500, 10, 400, 5, routeCost);
+    isTradeFavorable(kingdoms[a].resources, kingdoms[b].resources, kingdoms[b].resources, routeCost);
+}
+
+static void benchAllianceLookup(int i) {
+    int a = i % kingdomCount;
+    int b = (a + 1) % kingdomCount;
+    world.alliance->areAllied(kingdoms[a].name, kingdoms[b].name);
+    world.alliance->getTrustLevel(kingdoms[b].name, kingdoms[a].name);
+}
+
+// Sends until the fixed message store is full, then puts the history back
+static void benchMessageSend(int i) {
+    if (world.messagesSent >= MAX_MESSAGES) {
+        pauseTiming();
+        delete world.comm;
+        world.comm = new CommunicationSystem();
+        for (int m = 0; m < world.params.history; m++) {
+            world.comm->sendMessage("Envoy", kingdoms[0].name, "Greetings", TRADE_OFFER);
+        }
+        world.messagesSent = world.params.history;
+        resumeTiming();
+    }
+    world.comm->sendMessage(kingdoms[i % kingdomCount].name, kingdoms[(i + 1) % kingdomCount].name,
+                            "Greetings", TRADE_OFFER);
+    world.messagesSent++;
+}
+
+// Reading the inbox marks messages read, so they are reloaded every time
+static void benchMessageInbox(int i) {
+    pauseTiming();
+    if (i == 0) {
+        world.comm->saveMessagesToFile();
+    }
+    world.comm->loadMessagesFromFile();
+    world.replies.clear();
+    world.replies.str(string(2 * MAX_MESSAGES, 'n'));
+    resumeTiming();
+    world.comm->displayMessages(kingdoms[1 % kingdomCount].name);
+}
+
+// Places every kingdom on a freshly generated world
+static void benchMapPlace(int) {
+    pauseTiming();
+    delete world.map;
+    world.map = new MapSystem();
+    world.map->generateWorld(world.params.mapSize, world.params.mapSize, 1234);
+    resumeTiming();
+    KingdomData k;
+    for (int i = 0; i < world.params.kingdoms; i++) {
+        placeKingdom(*world.map, i, world.params.mapSize, k);
+    }
+}
+
+// Moves the first kingdom one tile and back again
+static void benchMapMove(int i) {
+    static const int stepX[4] = { 1, -1, 0, 0 };
+    static const int stepY[4] = { 0, 0, 1, -1 };
+    MapPosition seat = world.map->getPositionOf(0);
+    if (i % 2 == 1) {
+        world.map->moveKingdom(kingdoms[0].name, kingdoms[0].x, kingdoms[0].y);
+        return;
+    }
+    for (int d = 0; d < 4; d++) {
+        if (world.map->canSettle(seat.x + stepX[d], seat.y + stepY[d])) {
+            world.map->moveKingdom(kingdoms[0].name, seat.x + stepX[d], seat.y + stepY[d]);
+            return;
+        }
+    }
+}
+
+// Floods the tile next to the first kingdom's seat and drains it again,
+// then asks for the route the change may have broken
+static void benchMapTerrain(int i) {
+    MapPosition seat = world.map->getPositionOf(0);
+    int x = seat.x + 1 < world.params.mapSize ? seat.x + 1 : seat.x - 1;
+    world.map->setTerrain(x, seat.y, i % 2 == 0 ? TERRAIN_OCEAN : TERRAIN_PLAINS);
+    world.map->getRouteCost(0, 1 % kingdomCount);
+}
+
+// Draws the view at a different spot of the map each time
+static void benchMapRender(int i) {
+    int size = world.params.mapSize;
+    world.map->displayMap((i * 7) % size, (i * 13) % size, true);
+}
+
+static void benchSaveLoad(int) {
+    saveGameState(*world.population, *world.army, *world.economy, *world.resources, *world.bank,
+                  *world.comm, *world.alliance, *world.trade, *world.map);
+    loadGameState(*world.population, *world.army, *world.economy, *world.resources, *world.bank,
+                  *world.comm, *world.alliance, *world.trade, *world.map);
+}
+
+// One pass over every citizen: jobs are handed out, then each kingdom taxes
+static void benchCitizensTax(int) {
+    CitizenWorld& citizens = citizenWorld();
+    citizens.assignEmployment(0.6f);
+    for (int k = 0; k < citizens.getKingdomCount(); k++) {
+        citizens.collectTaxes(k, 0.1f);
+    }
+}
+
+// Jobless adults move from the first kingdom to the second and back
+static void benchCitizensMigrate(int i) {
+    CitizenWorld& citizens = citizenWorld();
+    if (i % 2 == 0) {
+        citizens.migrate(0, 1, 1000);
+    } else {
+        citizens.migrate(1, 0, 1000);
+    }
+}
+
+// One round: every kingdom ends its turn once and the plague spreads
+static void benchFullTurn(int) {
+    for (int i = 0; i < kingdomCount; i++) {
+        advanceTurn(*world.map, *world.epidemic, *world.events);
+    }
+}
+
+typedef void (*BenchOp)(int);
+
+struct Benchmark {
+    const char* name;
+    const char* kind;  // micro or macro
+    BenchAxis axis;
+    BenchOp op;
+};
+
+const Benchmark BENCHMARKS[] = {
+    { "battle.kingdomData",  "micro", AXIS_KINGDOMS, benchBattleKingdomData },
+    { "battle.warSystem",    "macro", AXIS_KINGDOMS, benchBattleWarSystem },
+    { "trade.evaluate",      "micro", AXIS_KINGDOMS, benchTradeEvaluate },
+    { "alliance.lookup",     "micro", AXIS_HISTORY,  benchAllianceLookup },
+    { "message.send",        "micro", AXIS_HISTORY,  benchMessageSend },
+    { "message.inbox",       "micro", AXIS_HISTORY,  benchMessageInbox },
+    { "map.place",           "macro", AXIS_MAP,      benchMapPlace },
+    { "map.move",            "micro", AXIS_MAP,      benchMapMove },
+    { "map.render",          "micro", AXIS_MAP,      benchMapRender },
+    { "map.terrain",         "micro", AXIS_MAP,      benchMapTerrain },
+    { "saveLoad.roundTrip",  "macro", AXIS_HISTORY,  benchSaveLoad },
+    { "saveLoad.mapSize",    "macro", AXIS_MAP,      benchSaveLoad },
+    { "citizens.tax",        "macro", AXIS_KINGDOMS, benchCitizensTax },
+    { "citizens.migrate",    "micro", AXIS_KINGDOMS, benchCitizensMigrate },
+    { "turn.full",           "macro", AXIS_KINGDOMS, benchFullTurn },
+    { "turn.mapSize",        "macro", AXIS_MAP,      benchFullTurn }
+};
+const int BENCHMARK_COUNT = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+struct BenchResult {
+    double nsPerOp;
+    double allocationsPerOp;
+    long long iterations;
+    PerfValues perfPerOp;
+};
+
+// Doubles the batch until one takes at least the target time
+static BenchResult runPoint(const Benchmark& bench, const BenchParams& params, long long targetNs) {
+    muteOutput();
+    streambuf* realInput = cin.rdbuf(world.replies.rdbuf());
+    buildWorld(params);
+
+    BenchResult result;
+    memset(&result, 0, sizeof(result));
+    long long batch = 1;
+    while (true) {
+        timerElapsed = 0;
+        pausedAllocations = 0;
+        pauseAllocationMark = AllocationStats::getAllocations();
+        unsigned long long allocationsBefore = AllocationStats::getAllocations();
+#ifdef __linux__
+        perfControl(PERF_EVENT_IOC_RESET);
+#endif
+        resumeTiming();
+        for (long long i = 0; i < batch; i++) {
+            bench.op((int)i);
+        }
+        pauseTiming();
+        unsigned long long allocations = AllocationStats::getAllocations() - allocationsBefore - pausedAllocations;
+
+        if (timerElapsed >= targetNs || batch >= (1LL << 30)) {
+            result.nsPerOp = (double)timerElapsed / batch;
+            result.allocationsPerOp = (double)allocations / batch;
+            result.iterations = batch;
+            result.perfPerOp = readPerfCounters();
+            for (int c = 0; c < PERF_COUNTER_COUNT; c++) {
+                result.perfPerOp.counts[c] /= batch;
+            }
+            break;
+        }
+        batch *= 2;
+    }
+
+    destroyWorld();
+    cin.rdbuf(realInput);
+    restoreOutput();
+    return result;
+}
+
+struct TerrainChange {
+    int x;
+    int y;
+    TerrainType terrain;
+    TerrainType old;
+};
+
+struct TerrainCheck {
+    int claims;  // Tiles claimed differently
+    int routes;  // Pairs of seats with a different route cost
+};
+
+// Settles the kingdoms of the changed map on a fresh copy of the world,
+// with the changes made first if they are still in place, and counts what
+// the two disagree on
+static void compareWithFresh(MapSystem& changed, int mapSize, const vector<TerrainChange>& changes,
+                             bool changesInPlace, TerrainCheck& result) {
+    MapSystem fresh;
+    fresh.generateWorld(mapSize, mapSize, 1234);
+    for (size_t i = 0; i < changes.size() && changesInPlace; i++) {
+        fresh.setTerrain(changes[i].x, changes[i].y, changes[i].terrain);
+    }
+    int seatCount = changed.getKingdomCount();
+    for (int i = 0; i < seatCount; i++) {
+        MapPosition position = changed.getPositionOf(i);
+        fresh.initializeKingdom(changed.getKingdomName(i), position.x, position.y);
+    }
+
+    for (int y = 0; y < mapSize; y++) {
+        for (int x = 0; x < mapSize; x++) {
+            if (changed.getTerritoryOwner(x, y) != fresh.getTerritoryOwner(x, y)) result.claims++;
+        }
+    }
+    for (int a = 0; a < seatCount; a++) {
+        for (int b = a + 1; b < seatCount; b++) {
+            if (changed.getRouteCost(a, b) != fresh.getRouteCost(a, b)) result.routes++;
+        }
+    }
+}
+
+// Changes terrain all around the first kingdom's seat on a settled map and
+// compares it with the same world where the changes were made before anyone
+// settled, then undoes them and compares it with the untouched world. The
+// routes are looked up before each step, so the settled map has to notice
+// which cached routes got dearer, and then which got cheaper again
+static TerrainCheck checkTerrainChanges(int mapSize) {
+    TerrainCheck result = { 0, 0 };
+    MapSystem changed;
+    changed.generateWorld(mapSize, mapSize, 1234);
+    KingdomData k = {};
+    for (int i = 0; i < MAX_KINGDOMS; i++) {
+        placeKingdom(changed, i, mapSize, k);
+    }
+    int seatCount = changed.getKingdomCount();
+    if (seatCount == 0) {
+        return result;
+    }
+    for (int a = 0; a < seatCount; a++) {
+        for (int b = a + 1; b < seatCount; b++) {
+            changed.getRouteCost(a, b);
+        }
+    }
+
+    // Every third tile within the rebuild window is flooded, raised into
+    // mountains or drained, seats excepted
+    vector<TerrainChange> changes;
+    MapPosition seat = changed.getPositionOf(0);
+    int reach = 2 * changed.getClaimRadius() + 1;
+    for (int dy = -reach; dy <= reach; dy++) {
+        for (int dx = -reach; dx <= reach; dx++) {
+            int x = seat.x + dx;
+            int y = seat.y + dy;
+            if ((dx + 2 * dy) % 3 != 0 || x < 0 || y < 0 || x >= mapSize || y >= mapSize ||
+                changed.isOccupied(x, y)) {
+                continue;
+            }
+            TerrainType old = (TerrainType)changed.getTile(x, y).terrain;
+            TerrainChange change = { x, y, old == TERRAIN_OCEAN ? TERRAIN_PLAINS :
+                                           (dx + dy) % 2 == 0 ? TERRAIN_OCEAN : TERRAIN_MOUNTAINS, old };
+            changed.setTerrain(x, y, change.terrain);
+            changes.push_back(change);
+        }
+    }
+    compareWithFresh(changed, mapSize, changes, true, result);
+
+    // compareWithFresh has just looked the routes up around the changes
+    for (size_t i = 0; i < changes.size(); i++) {
+        changed.setTerrain(changes[i].x, changes[i].y, changes[i].old);
+    }
+    compareWithFresh(changed, mapSize, changes, false, result);
+    return result;
+}
+
+// Every check at every map size, one line each
+static bool runChecks() {
+    bool passed = true;
+    for (size_t p = 0; p < sizeof(MAP_POINTS) / sizeof(int); p++) {
+        muteOutput();
+        TerrainCheck check = checkTerrainChanges(MAP_POINTS[p]);
+        restoreOutput();
+        cout << "check map.terrain    map=" << MAP_POINTS[p] << ": ";
+        if (check.claims == 0 && check.routes == 0) {
+            cout << "ok\n";
+        } else {
+            cout << check.claims << " tiles claimed and " << check.routes
+                 << " routes costed differently from a fresh map\n";
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+static bool matchesFilter(const char* name, int argc, char* argv[]) {
+    bool anyFilter = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0) i++;
+        if (i >= argc || argv[i][0] == '-') continue;
+        anyFilter = true;
+        if (strncmp(name, argv[i], strlen(argv[i])) == 0) return true;
+    }
+    return !anyFilter;
+}
+
+int main(int argc, char* argv[]) {
+    long long targetNs = 100000000;
+    bool wantPerf = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--check") == 0) return runChecks() ? 0 : 1;
+        if (strcmp(argv[i], "--quick") == 0) targetNs = 10000000;
+        if (strcmp(argv[i], "--perf") == 0) wantPerf = true;
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) TraceLog::enable(argv[i + 1]);
+    }
+    if (wantPerf && !openPerfCounters()) {
+        cout << "Hardware counters are not available here, timing only\n";
+    }
+
+    const char* axisNames[] = { "kingdoms", "map", "history" };
+    cout << "Benchmark            kind   parameter           ns/op   allocs/op  iterations  growth";
+    cout << (perfActive ? "     IPC  cache-miss/op  branch-miss/op\n" : "\n");
+    for (int b = 0; b < BENCHMARK_COUNT; b++) {
+        const Benchmark& bench = BENCHMARKS[b];
+        if (!matchesFilter(bench.name, argc, argv)) {
+            continue;
+        }
+
+        const int* points = bench.axis == AXIS_KINGDOMS ? KINGDOM_POINTS :
+                            bench.axis == AXIS_MAP ? MAP_POINTS : HISTORY_POINTS;
+        int pointCount = bench.axis == AXIS_KINGDOMS ? sizeof(KINGDOM_POINTS) / sizeof(int) :
+                         bench.axis == AXIS_MAP ? sizeof(MAP_POINTS) / sizeof(int) :
+                         sizeof(HISTORY_POINTS) / sizeof(int);
+        double firstNs = 0;
+        for (int p = 0; p < pointCount; p++) {
+            BenchParams params = DEFAULT_PARAMS;
+            if (bench.axis == AXIS_KINGDOMS) params.kingdoms = points[p];
+            if (bench.axis == AXIS_MAP) params.mapSize = points[p];
+            if (bench.axis == AXIS_HISTORY) params.history = points[p];
+
+            BenchResult result = runPoint(bench, params, targetNs);
+            if (p == 0) firstNs = result.nsPerOp;
+
+            char point[32];
+            char line[160];
+            snprintf(point, sizeof(point), "%s=%d", axisNames[bench.axis], points[p]);
+            char growth[32];
+            snprintf(growth, sizeof(growth), "x%.2f", firstNs > 0 ? result.nsPerOp / firstNs : 0.0);
+            snprintf(line, sizeof(line), perfActive ? "%-20s %-6s %-14s %10.1f %11.2f %11lld  %-7s" :
+                                                      "%-20s %-6s %-14s %10.1f %11.2f %11lld  %s",
+                     bench.name, bench.kind, point, result.nsPerOp,
+                     result.allocationsPerOp, result.iterations, growth);
+            cout << line;
+            if (perfActive) {
+                const double* perf = result.perfPerOp.counts;
+                snprintf(line, sizeof(line), " %6.2f %14.2f %15.2f",
+                         perf[PERF_CYCLES] > 0 ? perf[PERF_INSTRUCTIONS] / perf[PERF_CYCLES] : 0.0,
+                         perf[PERF_CACHE_MISSES], perf[PERF_BRANCH_MISSES]);
+                cout << line;
+            }
+            cout << "\n" << flush;
+        }
+    }
+    closePerfCounters();
+    return 0;
+}
+
+#endif // STRONGHOLD_BENCHMARK
@@ -0,0 +1,197 @@
+#include "Stronghold.h"
+
+// Same per-head tax as Economy::taxPopulation
+const int CITIZEN_CLASS_TAX[SOCIAL_CLASS_COUNT] = { 2, 5, 10 };
+
+// ---------------- CitizenArena ----------------
+
+CitizenArena::CitizenArena() {
+    buffer = 0;
+    capacity = 0;
+    used = 0;
+}
+
+CitizenArena::~CitizenArena() {
+    delete[] buffer;
+}
+
+// Throws away whatever was allocated and gets a fresh block
+void CitizenArena::reserve(size_t bytes) {
+    delete[] buffer;
+    buffer = new char[bytes];
+    capacity = bytes;
+    used = 0;
+}
+
+void* CitizenArena::allocate(size_t bytes, size_t alignment) {
+    size_t start = (used + alignment - 1) / alignment * alignment;
+    if (start + bytes > capacity) {
+        return 0;
+    }
+    used = start + bytes;
+    return buffer + start;
+}
+
+void CitizenArena::reset() {
+    used = 0;
+}
+
+// ---------------- CitizenStore ----------------
+
+CitizenStore::CitizenStore() {
+    capacity = 0;
+    count = 0;
+    ids = 0;
+    ages = 0;
+    classes = 0;
+    employed = 0;
+    wealth = 0;
+}
+
+// All component arrays come from one arena block sized for maxCitizens
+void CitizenStore::init(int maxCitizens) {
+    size_t perCitizen = sizeof(unsigned int) + sizeof(int) + 3 * sizeof(unsigned char);
+    arena.reserve(maxCitizens * perCitizen + 64);
+    ids = (unsigned int*)arena.allocate(maxCitizens * sizeof(unsigned int), sizeof(unsigned int));
+    wealth = (int*)arena.allocate(maxCitizens * sizeof(int), sizeof(int));
+    ages = (unsigned char*)arena.allocate(maxCitizens, 1);
+    classes = (unsigned char*)arena.allocate(maxCitizens, 1);
+    employed = (unsigned char*)arena.allocate(maxCitizens, 1);
+    capacity = maxCitizens;
+    count = 0;
+}
+
+// Returns the new citizen's index, or -1 if the kingdom is full
+int CitizenStore::spawn(unsigned int id, int age, int socialClass, int startingWealth) {
+    if (count >= capacity) {
+        return -1;
+    }
+    ids[count] = id;
+    ages[count] = (unsigned char)(age > 255 ? 255 : age);
+    classes[count] = (unsigned char)socialClass;
+    employed[count] = 0;
+    wealth[count] = startingWealth;
+    return count++;
+}
+
+// Fills the hole with the last citizen so the arrays stay packed
+void CitizenStore::remove(int index) {
+    if (index < 0 || index >= count) {
+        return;
+    }
+    count--;
+    ids[index] = ids[count];
+    ages[index] = ages[count];
+    classes[index] = classes[count];
+    employed[index] = employed[count];
+    wealth[index] = wealth[count];
+}
+
+// ---------------- CitizenWorld ----------------
+
+CitizenWorld::CitizenWorld(int kingdoms, int citizensPerKingdom) {
+    kingdomCount = kingdoms;
+    nextId = 1;
+    randomState = 2463534242u;
+    stores = new CitizenStore[kingdoms];
+    for (int k = 0; k < kingdoms; k++) {
+        stores[k].init(citizensPerKingdom);
+    }
+}
+
+CitizenWorld::~CitizenWorld() {
+    delete[] stores;
+}
+
+// xorshift, cheaper than rand() when called once per citizen
+unsigned int CitizenWorld::nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// Creates one citizen for every person in the kingdom's age cohorts
+void CitizenWorld::populateFrom(int kingdom, const Population& pop) {
+    CitizenStore& store = stores[kingdom];
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        for (int b = 0; b < AGE_BANDS; b++) {
+            int people = (int)(pop.getCohort(c, b) + 0.5f);
+            for (int p = 0; p < people; p++) {
+                int age = b * YEARS_PER_BAND + nextRandom() % YEARS_PER_BAND;
+                store.spawn(nextId++, age, c, CITIZEN_CLASS_TAX[c] * 10);
+            }
+        }
+    }
+}
+
+// Everyone gets a year older, then the old and unlucky die.
+// Returns the number of deaths
+int CitizenWorld::ageAll() {
+    int deaths = 0;
+    for (int k = 0; k < kingdomCount; k++) {
+        CitizenStore& store = stores[k];
+        unsigned char* ages = store.ages;
+        for (int i = 0; i < store.count; i++) {
+            ages[i] = ages[i] + (ages[i] < 255);
+        }
+        // Walk backwards so removing by swap never skips anyone
+        for (int i = store.count - 1; i >= 0; i--) {
+            int age = ages[i];
+            int chancePerThousand = age < 60 ? 5 : (age - 55) * 10;
+            if ((int)(nextRandom() % 1000) < chancePerThousand) {
+                store.remove(i);
+                deaths++;
+            }
+        }
+    }
+    return deaths;
+}
+
+// Working-age citizens (15-64) find a job with the given chance
+void CitizenWorld::assignEmployment(float employmentRate) {
+    unsigned int threshold = (unsigned int)(employmentRate * 1000);
+    for (int k = 0; k < kingdomCount; k++) {
+        CitizenStore& store = stores[k];
+        for (int i = 0; i < store.count; i++) {
+            int workingAge = (store.ages[i] >= 15) & (store.ages[i] < 65);
+            int hired = (nextRandom() % 1000) < threshold;
+            store.employed[i] = (unsigned char)(workingAge & hired);
+        }
+    }
+}
+
+// Employed citizens pay the same per-class tax as Economy::taxPopulation
+int CitizenWorld::collectTaxes(int kingdom, float taxRate) {
+    CitizenStore& store = stores[kingdom];
+    int gross = 0;
+    for (int i = 0; i < store.count; i++) {
+        int owed = store.employed[i] * CITIZEN_CLASS_TAX[store.classes[i]];
+        store.wealth[i] -= owed;
+        gross += owed;
+    }
+    return (int)(gross * taxRate);
+}
+
+// Unemployed adults leave for another kingdom. Returns how many moved;
+// moving within one kingdom is not migration and moves nobody
+int CitizenWorld::migrate(int fromKingdom, int toKingdom, int maxCitizens) {
+    if (fromKingdom == toKingdom || fromKingdom < 0 || fromKingdom >= kingdomCount ||
+        toKingdom < 0 || toKingdom >= kingdomCount) {
+        return 0;
+    }
+    CitizenStore& from = stores[fromKingdom];
+    CitizenStore& to = stores[toKingdom];
+    int moved = 0;
+    for (int i = from.count - 1; i >= 0 && moved < maxCitizens; i--) {
+        if (from.employed[i] || from.ages[i] < 15) {
+            continue;
+        }
+        if (to.spawn(from.ids[i], from.ages[i], from.classes[i], from.wealth[i]) < 0) {
+            break;
+        }
+        from.remove(i);
+        moved++;
+    }
+    return moved;
+}
@@ -8,6 +8,7 @@ Economy::Economy() {
 
 // Collects taxes from the population based on their class
 void Economy::taxPopulation(const Population& pop) {
+    ALLOCATION_SCOPE(SUBSYSTEM_ECONOMY);
     cout << "\n==================================================\n";
     cout << "                    TAX COLLECTION                 \n";
     cout << "==================================================\n";
@@ -37,6 +38,7 @@ void Economy::taxPopulation(const Population& pop) {
     cin >> collect;
     
     if (collect == 'y' || collect == 'Y') {
+        TRACE_SCOPE("Economy::taxPopulation");  // Only the collection, not the prompts
         int peasantTax = pop.getPeasantCount() * 2;
         int merchantTax = pop.getMerchantCount() * 5;
         int nobleTax = pop.getNobleCount() * 10;
@@ -70,13 +72,15 @@ void Economy::spend(int amount) {
 }
 
 void Economy::showStats() const {
-    cout << "\n==================================================\n";
-    cout << "                    ECONOMY OVERVIEW               \n";
-    cout << "==================================================\n";
-    cout << "Treasury: " << stateTreasury << " gold\n";
-    cout << "Tax Rate: " << (currentTaxRate * 100) << "%\n";
-    cout << "Inflation: " << (marketInflation * 100) << "%\n";
-    cout << "==================================================\n";
+    ScreenBuffer& screen = ScreenBuffer::console();
+    screen << "\n==================================================\n";
+    screen << "                    ECONOMY OVERVIEW               \n";
+    screen << "==================================================\n";
+    screen << "Treasury: " << stateTreasury << " gold\n";
+    screen << "Tax Rate: " << (currentTaxRate * 100) << "%\n";
+    screen << "Inflation: " << (marketInflation * 100) << "%\n";
+    screen << "==================================================\n";
+    screen.present();
 }
 
 void Economy::saveToFile() const {
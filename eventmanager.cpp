@@ -1,37 +1,401 @@
 #include "Stronghold.h"
+#include "MultiplayerSystems.h"
+
+// Titles of the hard-coded events; defined events keep theirs in the EventTable
+static const char* BUILTIN_EVENT_TITLES[BUILTIN_EVENT_COUNT] = {
+    "Agricultural Crisis", "Epidemic Outbreak", "Military Conflict", "Aristocratic Treason", "Geological Disaster"
+};
 
 EventManager::EventManager() {
+    handlerCount = 0;
+    epidemic = 0;
+    realmX = 0;
+    realmY = 0;
+    plagueDeathCarry = 0.0f;
+    kingdomsScheduled = 0;
+    for (int i = 0; i < MAX_EVENT_TYPES; i++) {
+        handlers[i] = 0;
+    }
+
+    // Designers define events in events.txt; the hard-coded ones are only
+    // used when that file is missing
+    if (definitions.loadFromFile("events.txt")) {
+        for (int i = 0; i < definitions.getEventCount(); i++) {
+            registerHandler(i, &EventManager::handleDefinedEvent);
+            setHazardRate(i, definitions.getRate(i));
+        }
+    } else {
+        registerBuiltinEvents();
+    }
+
+    scheduler.addKingdom(REALM_KINGDOM_ID, GameClock::now());
+}
+
+void EventManager::registerBuiltinEvents() {
+    registerHandler(EVENT_FAMINE, &EventManager::handleFamine);
+    registerHandler(EVENT_DISEASE, &EventManager::handleDisease);
+    registerHandler(EVENT_WAR, &EventManager::handleWar);
+    registerHandler(EVENT_BETRAYAL, &EventManager::handleBetrayal);
+    registerHandler(EVENT_EARTHQUAKE, &EventManager::handleEarthquake);
+
+    // Chance per turn of each event hitting a kingdom
+    setHazardRate(EVENT_FAMINE, 0.05);
+    setHazardRate(EVENT_DISEASE, 0.04);
+    setHazardRate(EVENT_WAR, 0.03);
+    setHazardRate(EVENT_BETRAYAL, 0.02);
+    setHazardRate(EVENT_EARTHQUAKE, 0.01);
+}
+
+void EventManager::registerHandler(int eventType, EventHandler handler) {
+    if (eventType < 0 || eventType >= MAX_EVENT_TYPES) {
+        return;
+    }
+    handlers[eventType] = handler;
+    if (eventType >= handlerCount) {
+        handlerCount = eventType + 1;
+    }
+}
+
+string EventManager::getTitle(int eventType) const {
+    if (eventType < definitions.getEventCount()) {
+        return definitions.getTitle(eventType);
+    }
+    return eventType < BUILTIN_EVENT_COUNT ? BUILTIN_EVENT_TITLES[eventType] : "";
+}
+
+// The realm and the multiplayer kingdoms face the same odds
+void EventManager::setHazardRate(int eventType, double ratePerTurn) {
+    scheduler.setHazardRate(eventType, ratePerTurn, GameClock::now());
+    kingdomScheduler.setHazardRate(eventType, ratePerTurn, GameClock::now());
+}
+
+// Lets disease events start a plague on the shared map at the realm's cell
+void EventManager::attachEpidemic(EpidemicSystem* system, int x, int y) {
+    epidemic = system;
+    realmX = x;
+    realmY = y;
 }
 
 void EventManager::trigger(Population& pop, Army& army, Economy& eco, ResourceManager& res) {
     cout << "\n==================================================\n";
     cout << "                    EVENT TRIGGER MENU                     \n";
     cout << "==================================================\n";
-    cout << "1. Agricultural Crisis                                  \n";
-    cout << "2. Epidemic Outbreak                                   \n";
-    cout << "3. Military Conflict                                   \n";
-    cout << "4. Aristocratic Treason                                \n";
-    cout << "5. Geological Disaster                                 \n";
+    cout << "Current Turn: " << GameClock::now() << "\n";
+    cout << "1. Advance One Turn                                    \n";
+    cout << "2. Skip To Next Event                                  \n";
+    cout << "3. Force A Specific Event                              \n";
     cout << "==================================================\n";
+    cout << "Choose an option: ";
+    int option;
+    cin >> option;
+
+    if (option == 1) {
+        advanceTurn(pop, army, eco, res);
+        return;
+    }
+    if (option == 2) {
+        skipToNextEvent(pop, army, eco, res);
+        return;
+    }
+    if (option != 3) {
+        cout << "Invalid selection.\n";
+        return;
+    }
+
+    for (int i = 0; i < handlerCount; i++) {
+        if (handlers[i] != 0) {
+            cout << (i + 1) << ". " << getTitle(i) << "\n";
+        }
+    }
     cout << "Select event to trigger: ";
     int eventSelection;
     cin >> eventSelection;
+    fire(eventSelection - 1, pop, army, eco, res);
+}
 
-    if (eventSelection == 1) {
-        famine(res, pop);
-    } else if (eventSelection == 2) {
-        disease(pop);
-    } else if (eventSelection == 3) {
-        war(army, eco);
-    } else if (eventSelection == 4) {
-        betrayal(eco);
-    } else if (eventSelection == 5) {
-        earthquake(res);
-    } else {
+// Looks the handler up in the table instead of walking an if/else chain
+void EventManager::fire(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res) {
+    if (eventType < 0 || eventType >= handlerCount || handlers[eventType] == 0) {
         cout << "Invalid selection.\n";
+        return;
+    }
+    (this->*handlers[eventType])(eventType, pop, army, eco, res);
+    Metrics::increment(METRIC_EVENTS_FIRED);
+}
+
+// The multiplayer kingdoms' events are fired by fireKingdomEvents
+void EventManager::fireDueEvents(Population& pop, Army& army, Economy& eco, ResourceManager& res) {
+    ScheduledEvent event;
+    bool anyFired = false;
+    while (scheduler.popDue(GameClock::now(), event)) {
+        // Defined events only strike when their conditions hold right now
+        if (event.eventType < definitions.getEventCount()) {
+            int stats[EVENT_STAT_COUNT];
+            readStats(pop, army, eco, res, stats);
+            if (!definitions.conditionsMet(event.eventType, stats)) {
+                continue;
+            }
+        }
+        fire(event.eventType, pop, army, eco, res);
+        anyFired = true;
+    }
+    if (!anyFired) {
+        cout << "The realm passes a quiet turn.\n";
     }
 }
 
+// Keeps one schedule per multiplayer kingdom, numbered as in kingdoms[].
+// Called whenever kingdoms are founded or loaded
+void EventManager::scheduleKingdoms(int count) {
+    while (kingdomsScheduled > count) {
+        kingdomsScheduled--;
+        kingdomScheduler.removeKingdom(kingdomsScheduled);
+    }
+    while (kingdomsScheduled < count) {
+        kingdomScheduler.addKingdom(kingdomsScheduled, GameClock::now());
+        kingdomsScheduled++;
+    }
+}
+
+// Strikes the multiplayer kingdoms with whatever has come due. They only
+// keep a handful of resources, so every event is applied as stat changes.
+// Returns true if any kingdom was hit
+bool EventManager::fireKingdomEvents(KingdomData* kingdoms, int count) {
+    ScheduledEvent event;
+    bool anyFired = false;
+    while (kingdomScheduler.popDue(GameClock::now(), event)) {
+        int type = event.eventType;
+        if (event.kingdomId >= count || type >= handlerCount || handlers[type] == 0) {
+            continue;
+        }
+        KingdomData& kingdom = kingdoms[event.kingdomId];
+        int stats[EVENT_STAT_COUNT];
+        readKingdomStats(kingdom.resources, stats);
+        if (type < definitions.getEventCount()) {
+            if (!definitions.conditionsMet(type, stats)) {
+                continue;
+            }
+            definitions.applyEffects(type, stats);
+            if (definitions.getOutbreakShare(type) > 0.0f && epidemic != 0) {
+                epidemic->seedOutbreak(kingdom.x, kingdom.y, definitions.getOutbreakShare(type));
+            }
+        } else {
+            applyBuiltinEvent(type, kingdom, stats);
+        }
+        cout << "Event: " << getTitle(type) << " strikes " << kingdom.name << ".\n";
+        writeKingdomStats(stats, kingdom.resources);
+        Metrics::increment(METRIC_EVENTS_FIRED);
+        anyFired = true;
+    }
+    return anyFired;
+}
+
+// What the built-in events do to the realm, as changes to a kingdom's stats
+void EventManager::applyBuiltinEvent(int eventType, const KingdomData& kingdom, int* stats) {
+    switch (eventType) {
+        case EVENT_FAMINE:
+            stats[STAT_FOOD] -= 100;
+            stats[STAT_POPULATION] -= 10;
+            break;
+        case EVENT_DISEASE:
+            if (epidemic != 0) {
+                epidemic->seedOutbreak(kingdom.x, kingdom.y, 0.05f);
+            } else {
+                stats[STAT_POPULATION] -= 15;
+            }
+            break;
+        case EVENT_WAR:
+            stats[STAT_MORALE] -= 20;
+            stats[STAT_TREASURY] -= 200;
+            break;
+        case EVENT_BETRAYAL:
+            stats[STAT_TREASURY] -= 300;
+            break;
+        case EVENT_EARTHQUAKE:
+            stats[STAT_STONE] -= 50;
+            break;
+    }
+}
+
+// Runs one turn of the plague and buries the realm's dead
+void EventManager::spreadEpidemic(Population& pop) {
+    if (epidemic == 0) {
+        return;
+    }
+    epidemic->stepTo(GameClock::now());
+    if (!epidemic->isActive()) {
+        return;
+    }
+    // Small realms lose less than one citizen a turn, so keep the fraction
+    plagueDeathCarry += pop.getTotal() * epidemic->getDeathRate(realmX, realmY);
+    int dead = (int)plagueDeathCarry;
+    plagueDeathCarry -= dead;
+    if (dead > 0) {
+        cout << "The plague claims " << dead << " citizens ("
+             << (int)(epidemic->getInfected(realmX, realmY) * 100) << "% of the realm is sick).\n";
+        pop.decrease(dead);
+    }
+}
+
+void EventManager::advanceTurn(Population& pop, Army& army, Economy& eco, ResourceManager& res) {
+    GameClock::advance();
+    cout << "\nTurn " << GameClock::now() << " begins.\n";
+    spreadEpidemic(pop);
+    fireDueEvents(pop, army, eco, res);
+}
+
+// Jumps the clock straight to the next scheduled event instead of
+// rolling dice for every turn in between
+void EventManager::skipToNextEvent(Population& pop, Army& army, Economy& eco, ResourceManager& res) {
+    int nextTurn = scheduler.nextDueTurn();
+    if (nextTurn < 0) {
+        cout << "No events are scheduled.\n";
+        return;
+    }
+    if (nextTurn <= GameClock::now()) {
+        nextTurn = GameClock::now() + 1;
+    }
+    cout << "\n" << (nextTurn - GameClock::now()) << " turn(s) pass...\n";
+    // A running plague still has to be stepped turn by turn
+    while (GameClock::now() < nextTurn - 1 && epidemic != 0 && epidemic->isActive()) {
+        GameClock::advance();
+        spreadEpidemic(pop);
+    }
+    GameClock::set(nextTurn);
+    cout << "Turn " << GameClock::now() << " begins.\n";
+    spreadEpidemic(pop);
+    fireDueEvents(pop, army, eco, res);
+}
+
+void EventManager::handleFamine(int, Population& pop, Army&, Economy&, ResourceManager& res) {
+    famine(res, pop);
+}
+
+void EventManager::handleDisease(int, Population& pop, Army&, Economy&, ResourceManager&) {
+    disease(pop);
+}
+
+void EventManager::handleWar(int, Population&, Army& army, Economy& eco, ResourceManager&) {
+    war(army, eco);
+}
+
+void EventManager::handleBetrayal(int, Population&, Army&, Economy& eco, ResourceManager&) {
+    betrayal(eco);
+}
+
+void EventManager::handleEarthquake(int, Population&, Army&, Economy&, ResourceManager& res) {
+    earthquake(res);
+}
+
+// Runs an event from events.txt: show its text, then add its stat deltas
+void EventManager::handleDefinedEvent(int eventType, Population& pop, Army& army, Economy& eco, ResourceManager& res) {
+    string title = definitions.getTitle(eventType);
+    for (size_t i = 0; i < title.size(); i++) {
+        title[i] = toupper(title[i]);
+    }
+    cout << "\n==================================================\n";
+    cout << "                    " << title << "\n";
+    cout << "==================================================\n";
+    cout << definitions.getText(eventType);
+    cout << "==================================================\n";
+
+    if (definitions.getOutbreakShare(eventType) > 0.0f && epidemic != 0) {
+        epidemic->seedOutbreak(realmX, realmY, definitions.getOutbreakShare(eventType));
+    }
+
+    int stats[EVENT_STAT_COUNT];
+    readStats(pop, army, eco, res, stats);
+    definitions.applyEffects(eventType, stats);
+    writeStats(stats, pop, army, eco, res);
+}
+
+void EventManager::readStats(const Population& pop, const Army& army, const Economy& eco,
+                             const ResourceManager& res, int* stats) const {
+    stats[STAT_POPULATION] = pop.getTotal();
+    stats[STAT_HAPPINESS] = (int)pop.getHappiness();
+    stats[STAT_SOLDIERS] = army.getSoldierCount();
+    stats[STAT_MORALE] = army.getMorale();
+    stats[STAT_TREASURY] = eco.getTreasury();
+    stats[STAT_FOOD] = res.getFoodStock();
+    stats[STAT_WOOD] = res.getTimberStock();
+    stats[STAT_STONE] = res.getStoneStock();
+    stats[STAT_METAL] = res.getMetalStock();
+}
+
+// Writes event results back, keeping every value inside its normal range
+void EventManager::writeStats(const int* stats, Population& pop, Army& army, Economy& eco,
+                              ResourceManager& res) const {
+    int population = stats[STAT_POPULATION] < 0 ? 0 : stats[STAT_POPULATION];
+    if (population != pop.getTotal()) {
+        pop.decrease(pop.getTotal() - population);
+    }
+    int happiness = stats[STAT_HAPPINESS];
+    if (happiness < 0) happiness = 0;
+    if (happiness > 100) happiness = 100;
+    if (happiness != (int)pop.getHappiness()) {
+        pop.setHappiness(happiness);
+    }
+
+    int morale = stats[STAT_MORALE];
+    if (morale < 0) morale = 0;
+    if (morale > 100) morale = 100;
+    army.setSoldierCount(stats[STAT_SOLDIERS] < 0 ? 0 : stats[STAT_SOLDIERS]);
+    army.setMorale(morale);
+
+    // Like Economy::spend, a loss the treasury cannot cover is refused
+    if (stats[STAT_TREASURY] < 0) {
+        cout << "Not enough gold in treasury!\n";
+    } else {
+        eco.setTreasury(stats[STAT_TREASURY]);
+    }
+
+    res.setFoodStock(stats[STAT_FOOD] < 0 ? 0 : stats[STAT_FOOD]);
+    res.setTimberStock(stats[STAT_WOOD] < 0 ? 0 : stats[STAT_WOOD]);
+    res.setStoneStock(stats[STAT_STONE] < 0 ? 0 : stats[STAT_STONE]);
+    res.setMetalStock(stats[STAT_METAL] < 0 ? 0 : stats[STAT_METAL]);
+}
+
+// Kingdoms keep one pool of materials, so wood, stone and metal all read
+// it and a change to any of them lands on it
+void EventManager::readKingdomStats(const KingdomResources& resources, int* stats) const {
+    stats[STAT_POPULATION] = resources.population;
+    stats[STAT_HAPPINESS] = resources.happiness;
+    stats[STAT_SOLDIERS] = resources.army;
+    stats[STAT_MORALE] = resources.morale;
+    stats[STAT_TREASURY] = resources.gold;
+    stats[STAT_FOOD] = resources.food;
+    stats[STAT_WOOD] = resources.materials;
+    stats[STAT_STONE] = resources.materials;
+    stats[STAT_METAL] = resources.materials;
+}
+
+// Only the stats an event changed are brought back into range; a kingdom
+// may already sit above 100 morale after a victory
+void EventManager::writeKingdomStats(const int* stats, KingdomResources& resources) const {
+    int materials = resources.materials + (stats[STAT_WOOD] - resources.materials) +
+                    (stats[STAT_STONE] - resources.materials) + (stats[STAT_METAL] - resources.materials);
+    if (stats[STAT_HAPPINESS] != resources.happiness) {
+        int happiness = stats[STAT_HAPPINESS];
+        if (happiness < 0) happiness = 0;
+        if (happiness > 100) happiness = 100;
+        resources.happiness = happiness;
+    }
+    if (stats[STAT_MORALE] != resources.morale) {
+        int morale = stats[STAT_MORALE];
+        if (morale < 0) morale = 0;
+        if (morale > 100) morale = 100;
+        resources.morale = morale;
+    }
+    resources.population = stats[STAT_POPULATION] < 0 ? 0 : stats[STAT_POPULATION];
+    resources.army = stats[STAT_SOLDIERS] < 0 ? 0 : stats[STAT_SOLDIERS];
+    // As for the realm, a loss the treasury cannot cover is refused
+    if (stats[STAT_TREASURY] >= 0) {
+        resources.gold = stats[STAT_TREASURY];
+    }
+    resources.food = stats[STAT_FOOD] < 0 ? 0 : stats[STAT_FOOD];
+    resources.materials = materials < 0 ? 0 : materials;
+}
+
 // Bad harvest leads to food shortage and population problems
 void EventManager::famine(ResourceManager& res, Population& pop) {
     cout << "\n==================================================\n";
@@ -45,12 +409,19 @@ void EventManager::famine(ResourceManager& res, Population& pop) {
     pop.decrease(10);
 }
 
-// Disease spreads through the population
+// Disease starts a plague that spreads over the map; without a map it
+// just takes its toll on the spot
 void EventManager::disease(Population& pop) {
     cout << "\n==================================================\n";
     cout << "                    EPIDEMIC OUTBREAK                      \n";
     cout << "==================================================\n";
     cout << "A deadly plague spreads through the population!\n";
+    if (epidemic != 0) {
+        cout << "The sickness will spread to nearby and trading cities.\n";
+        cout << "==================================================\n";
+        epidemic->seedOutbreak(realmX, realmY, 0.05f);
+        return;
+    }
     cout << "15 citizens have perished from the disease.\n";
     cout << "==================================================\n";
     pop.decrease(15);
@@ -0,0 +1,135 @@
+#include "Stronghold.h"
+#include <cmath>
+#include <cstdlib>
+
+int GameClock::currentTurn = 0;
+
+int GameClock::now() {
+    return currentTurn;
+}
+
+void GameClock::advance() {
+    currentTurn++;
+    AllocationStats::endTurn();
+    Metrics::endTurn();
+}
+
+// A jump of several turns is tallied as one
+void GameClock::set(int turn) {
+    if (turn > currentTurn) {
+        AllocationStats::endTurn();
+        Metrics::endTurn(turn - currentTurn);
+    }
+    currentTurn = turn;
+}
+
+EventScheduler::EventScheduler() {
+    eventTypeCount = 0;
+    for (int i = 0; i < MAX_EVENT_TYPES; i++) {
+        hazardRates[i] = 0.0;
+    }
+}
+
+// Number of turns until the next occurrence. Each turn the event fires with
+// probability ratePerTurn, so the wait is geometric and can be drawn in one go
+int EventScheduler::drawDelay(double ratePerTurn) const {
+    if (ratePerTurn >= 1.0) {
+        return 1;
+    }
+    double u = (rand() + 1.0) / (RAND_MAX + 1.0);
+    double delay = floor(log(u) / log(1.0 - ratePerTurn));
+    if (delay > 1000000) delay = 1000000;
+    return 1 + (int)delay;
+}
+
+void EventScheduler::schedule(int kingdomId, int eventType, int fromTurn) {
+    if (hazardRates[eventType] <= 0.0) {
+        return;
+    }
+    ScheduledEvent event;
+    event.dueTurn = fromTurn + drawDelay(hazardRates[eventType]);
+    event.kingdomId = kingdomId;
+    event.eventType = eventType;
+    upcoming.push(event);
+}
+
+// Takes pending events out of the queue; -1 matches any kingdom or type
+void EventScheduler::dropEvents(int kingdomId, int eventType) {
+    vector<ScheduledEvent> kept;
+    while (!upcoming.empty()) {
+        const ScheduledEvent& event = upcoming.top();
+        if ((kingdomId != -1 && event.kingdomId != kingdomId) ||
+            (eventType != -1 && event.eventType != eventType)) {
+            kept.push_back(event);
+        }
+        upcoming.pop();
+    }
+    for (size_t i = 0; i < kept.size(); i++) {
+        upcoming.push(kept[i]);
+    }
+}
+
+// Changing a rate redraws every pending event of that type. The wait is
+// memoryless, so drawing again from the current turn is still fair
+void EventScheduler::setHazardRate(int eventType, double ratePerTurn, int currentTurn) {
+    if (eventType < 0 || eventType >= MAX_EVENT_TYPES) {
+        return;
+    }
+    if (ratePerTurn < 0.0) ratePerTurn = 0.0;
+    hazardRates[eventType] = ratePerTurn;
+    if (eventType >= eventTypeCount) {
+        eventTypeCount = eventType + 1;
+    }
+
+    dropEvents(-1, eventType);
+    for (size_t i = 0; i < kingdomIds.size(); i++) {
+        schedule(kingdomIds[i], eventType, currentTurn);
+    }
+}
+
+double EventScheduler::getHazardRate(int eventType) const {
+    if (eventType < 0 || eventType >= MAX_EVENT_TYPES) {
+        return 0.0;
+    }
+    return hazardRates[eventType];
+}
+
+void EventScheduler::addKingdom(int kingdomId, int currentTurn) {
+    kingdomIds.push_back(kingdomId);
+    for (int type = 0; type < eventTypeCount; type++) {
+        schedule(kingdomId, type, currentTurn);
+    }
+}
+
+void EventScheduler::removeKingdom(int kingdomId) {
+    for (size_t i = 0; i < kingdomIds.size(); i++) {
+        if (kingdomIds[i] == kingdomId) {
+            kingdomIds.erase(kingdomIds.begin() + i);
+            dropEvents(kingdomId, -1);
+            return;
+        }
+    }
+}
+
+// Takes the earliest event that is due by currentTurn and draws its next occurrence
+bool EventScheduler::popDue(int currentTurn, ScheduledEvent& event) {
+    if (upcoming.empty() || upcoming.top().dueTurn > currentTurn) {
+        return false;
+    }
+    event = upcoming.top();
+    upcoming.pop();
+    schedule(event.kingdomId, event.eventType, event.dueTurn);
+    return true;
+}
+
+// Returns -1 when nothing is scheduled
+int EventScheduler::nextDueTurn() const {
+    if (upcoming.empty()) {
+        return -1;
+    }
+    return upcoming.top().dueTurn;
+}
+
+bool EventScheduler::empty() const {
+    return upcoming.empty();
+}
@@ -0,0 +1,168 @@
+#include "Stronghold.h"
+#include <sstream>
+#include <climits>
+
+const char* EVENT_STAT_NAMES[EVENT_STAT_COUNT] = {
+    "population",
+    "happiness",
+    "soldiers",
+    "morale",
+    "treasury",
+    "food",
+    "wood",
+    "stone",
+    "metal"
+};
+
+EventTable::EventTable() {
+    eventCount = 0;
+}
+
+int EventTable::findStat(const string& name) {
+    for (int i = 0; i < EVENT_STAT_COUNT; i++) {
+        if (name == EVENT_STAT_NAMES[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Appends an event with open conditions and no effects
+int EventTable::addEvent(const string& title) {
+    titles.push_back(title);
+    texts.push_back("");
+    rates.push_back(0.0);
+    outbreakShares.push_back(0.0f);
+    for (int c = 0; c < MAX_EVENT_CONDITIONS; c++) {
+        conditionStats.push_back(0);
+        conditionMin.push_back(INT_MIN);
+        conditionMax.push_back(INT_MAX);
+    }
+    for (int s = 0; s < EVENT_STAT_COUNT; s++) {
+        effectDeltas.push_back(0);
+    }
+    return eventCount++;
+}
+
+// Reads definitions like:
+//   event Agricultural Crisis
+//   rate 0.05
+//   text A devastating famine has struck the realm!
+//   when food 100 999999
+//   effect food -100
+//   outbreak 5
+//   end
+// Lines starting with # are comments. Returns false if nothing was loaded
+bool EventTable::loadFromFile(const string& fileName) {
+    ifstream in(fileName.c_str());
+    if (!in) {
+        return false;
+    }
+
+    string line;
+    int lineNumber = 0;
+    int current = -1;
+    int conditionsUsed = 0;
+    while (getline(in, line)) {
+        lineNumber++;
+        istringstream words(line);
+        string keyword;
+        if (!(words >> keyword) || keyword[0] == '#') {
+            continue;
+        }
+
+        if (keyword == "event") {
+            if (eventCount >= MAX_EVENT_TYPES) {
+                cout << fileName << ":" << lineNumber << ": too many events, ignoring the rest.\n";
+                break;
+            }
+            string title;
+            getline(words >> ws, title);
+            current = addEvent(title);
+            conditionsUsed = 0;
+            continue;
+        }
+        if (current < 0) {
+            cout << fileName << ":" << lineNumber << ": '" << keyword << "' outside of an event.\n";
+            continue;
+        }
+
+        if (keyword == "rate") {
+            words >> rates[current];
+        } else if (keyword == "text") {
+            string text;
+            getline(words >> ws, text);
+            texts[current] += text + "\n";
+        } else if (keyword == "when" || keyword == "effect") {
+            string statName;
+            words >> statName;
+            int stat = findStat(statName);
+            if (stat < 0) {
+                cout << fileName << ":" << lineNumber << ": unknown stat '" << statName << "'.\n";
+                continue;
+            }
+            if (keyword == "effect") {
+                int amount = 0;
+                words >> amount;
+                effectDeltas[current * EVENT_STAT_COUNT + stat] += amount;
+            } else if (conditionsUsed >= MAX_EVENT_CONDITIONS) {
+                cout << fileName << ":" << lineNumber << ": too many conditions for one event.\n";
+            } else {
+                int slot = current * MAX_EVENT_CONDITIONS + conditionsUsed;
+                conditionStats[slot] = (unsigned char)stat;
+                words >> conditionMin[slot] >> conditionMax[slot];
+                conditionsUsed++;
+            }
+        } else if (keyword == "outbreak") {
+            float percent = 0.0f;
+            words >> percent;
+            outbreakShares[current] = percent / 100.0f;
+        } else if (keyword == "end") {
+            current = -1;
+        } else {
+            cout << fileName << ":" << lineNumber << ": unknown keyword '" << keyword << "'.\n";
+        }
+    }
+    in.close();
+    return eventCount > 0;
+}
+
+int EventTable::getEventCount() const {
+    return eventCount;
+}
+
+string EventTable::getTitle(int eventId) const {
+    return titles[eventId];
+}
+
+string EventTable::getText(int eventId) const {
+    return texts[eventId];
+}
+
+double EventTable::getRate(int eventId) const {
+    return rates[eventId];
+}
+
+// Share of the kingdom's people infected when the event starts a plague
+float EventTable::getOutbreakShare(int eventId) const {
+    return outbreakShares[eventId];
+}
+
+// Unused slots hold the full int range, so every slot can be tested
+// without checking how many conditions the event really has
+bool EventTable::conditionsMet(int eventId, const int* stats) const {
+    int base = eventId * MAX_EVENT_CONDITIONS;
+    int passed = 1;
+    for (int c = 0; c < MAX_EVENT_CONDITIONS; c++) {
+        int value = stats[conditionStats[base + c]];
+        passed &= (value >= conditionMin[base + c]) & (value <= conditionMax[base + c]);
+    }
+    return passed != 0;
+}
+
+void EventTable::applyEffects(int eventId, int* stats) const {
+    const int* row = &effectDeltas[eventId * EVENT_STAT_COUNT];
+    for (int s = 0; s < EVENT_STAT_COUNT; s++) {
+        stats[s] += row[s];
+    }
+}
@@ -2,6 +2,7 @@
 
 // Base constructor, just sets the name
 Leader::Leader(string n) {
+    ALLOCATION_SCOPE(SUBSYSTEM_KINGDOMS);
     rulerName = n;
 }
 
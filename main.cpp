@@ -1,6 +1,7 @@
 #include <iostream>
 #include <fstream>
 #include <ctime>
+#include <cstring>
 #include "Stronghold.h"  
 #include "MultiplayerSystems.h"
 
@@ -18,39 +19,54 @@ void loadGameState(Population& pop, Army& army, Economy& eco,
 
 void multiplayerManagementMenu(Kingdom& playerKingdom, Population& realmCitizens, 
                              Army& realmForces, Economy& realmEconomy, 
-                             WarSystem& warSystem, MapSystem& mapSystem);
+                             WarSystem& warSystem, MapSystem& mapSystem, EventManager& events);
 
 void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem,
-                          CommunicationSystem& commSystem);
-
-// Multiplayer Kingdom Data Structure 
-struct KingdomResources {
-    int gold;
-    int food;
-    int army;
-    int materials;  // For buildings and equipment
-    int population;
-    int morale;
-    int happiness;
-};
-
-struct KingdomData {
-    string name;
-    int x, y;
-    KingdomResources resources;
-};
+                          CommunicationSystem& commSystem, TradeSystem& tradeSystem,
+                          EpidemicSystem& epidemic, MapSystem& mapSystem, EventManager& events);
 
 KingdomData kingdoms[MAX_KINGDOMS];
 int kingdomCount = 0;
 int activeKingdomIndex = 0;
 
+// People of each kingdom by class and age, one kingdom after another so
+// a whole round ages in one batch. Empty until a kingdom first ages
+float kingdomCohorts[MAX_KINGDOMS][COHORTS_PER_KINGDOM];
+
 //  Alliance and War Tracking 
 bool alliances[MAX_KINGDOMS][MAX_KINGDOMS] = {false};
 bool wars[MAX_KINGDOMS][MAX_KINGDOMS] = {false};
 
+// Kingdoms ranked by each resource, and world-wide sums of each, kept in
+// step by calling kingdomChanged() whenever a kingdom's resources change
+KingdomLeaderboards leaderboards;
+WorldTotals worldTotals(kingdoms, &kingdomCount);
+
+void kingdomChanged(int kingdom) {
+    leaderboards.update(kingdom, kingdoms[kingdom].resources);
+    worldTotals.markDirty();
+}
+
+// World summary for outside dashboards, only open with --live-stats
+LiveStatsPublisher liveStats;
+
+// Subsystem charged for the heap use of each main menu and multiplayer
+// action choice (index 0 is unused)
+const int MENU_SUBSYSTEM[12] = {
+    SUBSYSTEM_OTHER, SUBSYSTEM_OTHER, SUBSYSTEM_POPULATION, SUBSYSTEM_ARMY, SUBSYSTEM_ECONOMY,
+    SUBSYSTEM_RESOURCES, SUBSYSTEM_EVENTS, SUBSYSTEM_KINGDOMS, SUBSYSTEM_KINGDOMS,
+    SUBSYSTEM_SAVE_LOAD, SUBSYSTEM_SAVE_LOAD, SUBSYSTEM_OTHER
+};
+const int ACTION_SUBSYSTEM[14] = {
+    SUBSYSTEM_OTHER, SUBSYSTEM_ALLIANCE, SUBSYSTEM_ALLIANCE, SUBSYSTEM_ALLIANCE, SUBSYSTEM_WAR,
+    SUBSYSTEM_WAR, SUBSYSTEM_WAR, SUBSYSTEM_MESSAGES, SUBSYSTEM_TRADE, SUBSYSTEM_MAP, SUBSYSTEM_MAP,
+    SUBSYSTEM_KINGDOMS, SUBSYSTEM_TRADE, SUBSYSTEM_OTHER
+};
+
 // Helper functions
 int calculateRecommendedArmy(int population);
-bool isTradeFavorable(const KingdomResources& offering, const KingdomResources& requesting, const KingdomResources& kingdom);
+bool isTradeFavorable(const KingdomResources& offering, const KingdomResources& requesting, const KingdomResources& kingdom,
+                      int routeCost = 0);
 
 // Random number generator using time
 int getRandomNumber(int min, int max) {
@@ -72,18 +88,26 @@ const char* AI_RESPONSES[] = {
 const int NUM_RESPONSES = 5;
 
 // Calculate initial kingdom stats based on position and surroundings
-void calculateInitialStats(KingdomData& k, int x, int y, const KingdomData* existingKingdoms, int count) {
-    // Base population based on position (corners and center are better)
-    int basePop = 1000;
-    if ((x == 0 || x == 3) && (y == 0 || y == 3)) basePop = 1500; // Corners
-    else if (x == 1 && y == 1) basePop = 2000; // Center
-    
-    // It will adjust population based on nearby kingdoms
-    for (int i = 0; i < count; i++) {
-        int dist = abs(existingKingdoms[i].x - x) + abs(existingKingdoms[i].y - y);
-        if (dist == 1) basePop += 500;  // Adjacent kingdoms increase population
+void calculateInitialStats(KingdomData& k, int x, int y, const MapSystem& map) {
+    // Base population depends on the land the kingdom is seated on
+    const TerrainInfo& terrain = map.getTerrain(x, y);
+    int basePop = 1000 + terrain.populationBonus;
+
+    // Rich land in the surrounding region feeds more people
+    basePop += map.regionAround(REGION_YIELD, x, y, 2) * 20;
+
+    // Only kingdoms within two tiles matter, so one radius query finds them all
+    vector<int> nearby;
+    map.getKingdomsWithin(x, y, 2, nearby);
+    int adjacent = 0;
+    int tradeRoutes = (int)nearby.size();
+    for (size_t i = 0; i < nearby.size(); i++) {
+        MapPosition pos = map.getPositionOf(nearby[i]);
+        int dist = abs(pos.x - x) + abs(pos.y - y);
+        if (dist == 1) adjacent++;
         if (dist == 2) basePop += 200;  // Nearby kingdoms have some effect
     }
+    basePop += adjacent * 500;  // Adjacent kingdoms increase population
     
     // Calculate population distribution
     int peasants = basePop * 0.8 + getRandomNumber(-100, 100);
@@ -99,20 +123,13 @@ void calculateInitialStats(KingdomData& k, int x, int y, const KingdomData* exis
     
 
     // Morale based on position and nearby kingdoms
-    k.resources.morale = 50;
-    if ((x == 0 || x == 3) && (y == 0 || y == 3)) k.resources.morale += 10; // Corners are defensible
-    for (int i = 0; i < count; i++) {
-        int dist = abs(existingKingdoms[i].x - x) + abs(existingKingdoms[i].y - y);
-        if (dist == 1) k.resources.morale -= 5;  // Adjacent kingdoms reduce morale
-    }
+    k.resources.morale = 50 + terrain.defenseBonus; // Hills and forests are defensible
+    k.resources.morale -= adjacent * 5;  // Adjacent kingdoms reduce morale
+    k.resources.morale -= map.regionAround(REGION_MILITARY, x, y, 2) / 200;  // So do foreign armies
+    if (k.resources.morale < 10) k.resources.morale = 10;
     
     // THe Economy is based on the position and trade potential
     k.resources.gold = 5000;
-    int tradeRoutes = 0;
-    for (int i = 0; i < count; i++) {
-        int dist = abs(existingKingdoms[i].x - x) + abs(existingKingdoms[i].y - y);
-        if (dist <= 2) tradeRoutes++;
-    }
     k.resources.gold += tradeRoutes * 1000;
     
     // Happines is based on the initial conditions
@@ -121,6 +138,136 @@ void calculateInitialStats(KingdomData& k, int x, int y, const KingdomData* exis
     if (k.resources.gold > 7000) k.resources.happiness += 10;
 }
 
+// Keeps the map's population and military layers, and how far each
+// kingdom's scouts see, in step with the kingdoms
+void updateMapLayers(MapSystem& map) {
+    for (int i = 0; i < kingdomCount; i++) {
+        map.setRegionValue(REGION_POPULATION, kingdoms[i].x, kingdoms[i].y, kingdoms[i].resources.population);
+        map.setRegionValue(REGION_MILITARY, kingdoms[i].x, kingdoms[i].y, kingdoms[i].resources.army);
+        map.setSightRadius(i, BASE_SIGHT_RADIUS + kingdoms[i].resources.army / 500);
+    }
+}
+
+// Copies the kingdoms, alliances and wars into the shared segment
+void publishLiveStats() {
+    if (!liveStats.isOpen()) return;
+    LiveStatsSnapshot snapshot;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.magic = LIVE_STATS_MAGIC;
+    snapshot.version = LIVE_STATS_VERSION;
+    snapshot.turn = GameClock::now();
+    snapshot.kingdomCount = kingdomCount;
+    snapshot.activeKingdom = activeKingdomIndex;
+    for (int i = 0; i < kingdomCount; i++) {
+        LiveKingdomStats& stats = snapshot.kingdoms[i];
+        strncpy(stats.name, kingdoms[i].name.c_str(), LIVE_STATS_NAME_LENGTH - 1);
+        stats.x = kingdoms[i].x;
+        stats.y = kingdoms[i].y;
+        stats.gold = kingdoms[i].resources.gold;
+        stats.army = kingdoms[i].resources.army;
+        stats.population = kingdoms[i].resources.population;
+        stats.happiness = kingdoms[i].resources.happiness;
+        stats.morale = kingdoms[i].resources.morale;
+        for (int j = 0; j < kingdomCount; j++) {
+            if (j == i) continue;
+            if (alliances[i][j]) stats.allies++;
+            if (wars[i][j]) stats.wars++;
+            if (j > i && alliances[i][j]) snapshot.allianceCount++;
+            if (j > i && wars[i][j]) snapshot.warCount++;
+        }
+    }
+    liveStats.publish(snapshot);
+}
+
+// Prints what a running game has published, for --read-live-stats
+int printLiveStats(const string& name) {
+    LiveStatsSnapshot snapshot;
+    if (!LiveStatsPublisher::read(name, snapshot)) {
+        cout << "No live stats published under " << name << endl;
+        return 1;
+    }
+    cout << "Turn " << snapshot.turn << ", " << snapshot.kingdomCount << " kingdoms, "
+         << snapshot.allianceCount << " alliances, " << snapshot.warCount << " wars\n";
+    for (int i = 0; i < snapshot.kingdomCount && i < MAX_KINGDOMS; i++) {
+        const LiveKingdomStats& stats = snapshot.kingdoms[i];
+        cout << (i == snapshot.activeKingdom ? "* " : "  ") << stats.name << " (" << stats.x << "," << stats.y << ")"
+             << " gold " << stats.gold << ", army " << stats.army << " (morale " << stats.morale << "%)"
+             << ", population " << stats.population << ", happiness " << stats.happiness << "%"
+             << ", allies " << stats.allies << ", wars " << stats.wars << "\n";
+    }
+    return 0;
+}
+
+// Every kingdom's people age a year. The cohorts are first fitted to the
+// head count, which trades, wars and the plague change in between
+void ageKingdoms() {
+    float happiness[MAX_KINGDOMS];
+    for (int i = 0; i < kingdomCount; i++) {
+        Population::fitCohorts(kingdomCohorts[i], kingdoms[i].resources.population);
+        happiness[i] = kingdoms[i].resources.happiness;
+    }
+    Population::advanceCohortBatch(kingdomCohorts[0], happiness, kingdomCount);
+    for (int i = 0; i < kingdomCount; i++) {
+        int total = (int)(Population::cohortTotal(kingdomCohorts[i]) + 0.5f);
+        if (total != kingdoms[i].resources.population) {
+            kingdoms[i].resources.population = total;
+            kingdomChanged(i);
+        }
+    }
+}
+
+// Hands control to the next kingdom. Once every kingdom has moved the
+// game clock ticks, the kingdoms age, the plague spreads one turn and due
+// events strike
+void advanceTurn(MapSystem& map, EpidemicSystem& epidemic, EventManager& events) {
+    TRACE_SCOPE("advanceTurn");
+    ALLOCATION_SCOPE(SUBSYSTEM_KINGDOMS);
+    activeKingdomIndex = (activeKingdomIndex + 1) % kingdomCount;
+    if (activeKingdomIndex == 0) {
+        Metrics::set(METRIC_KINGDOM_POPULATION, worldTotals.get(RANK_POPULATION));
+        GameClock::advance();
+        ageKingdoms();
+        epidemic.stepTo(GameClock::now());
+    }
+    if (activeKingdomIndex == 0 && epidemic.isActive()) {
+        for (int i = 0; i < kingdomCount; ++i) {
+            // Small kingdoms lose less than one citizen a turn, so keep the fraction
+            kingdoms[i].plagueDeathCarry += kingdoms[i].resources.population *
+                                            epidemic.getDeathRate(kingdoms[i].x, kingdoms[i].y);
+            int dead = (int)kingdoms[i].plagueDeathCarry;
+            kingdoms[i].plagueDeathCarry -= dead;
+            if (dead > 0) {
+                kingdoms[i].resources.population -= dead;
+                kingdomChanged(i);
+                cout << "Plague: " << kingdoms[i].name << " lost " << dead << " citizens.\n";
+            }
+        }
+    }
+    if (activeKingdomIndex == 0 && events.fireKingdomEvents(kingdoms, kingdomCount)) {
+        for (int i = 0; i < kingdomCount; ++i) {
+            kingdomChanged(i);
+        }
+    }
+    updateMapLayers(map);
+    publishLiveStats();
+}
+
+// Allies share what their scouts see
+bool canSeeKingdom(const MapSystem& map, int viewer, int target) {
+    if (map.canSeeKingdom(viewer, target)) return true;
+    for (int i = 0; i < kingdomCount; i++) {
+        if (i != viewer && alliances[viewer][i] && map.canSeeKingdom(i, target)) return true;
+    }
+    return false;
+}
+
+// The exact figure when the kingdom can be seen, otherwise a rough guess
+string scoutReport(int value, bool visible) {
+    if (visible) return to_string(value);
+    int step = value < 1000 ? 100 : 500;
+    return "~" + to_string((value + step / 2) / step * step);
+}
+
 // Calculate battle outcome based on actual kingdom stats
 int calculateBattleOutcome(const KingdomData& attacker, const KingdomData& defender) {
     // Base strength calculation
@@ -147,9 +294,11 @@ int calculateBattleOutcome(const KingdomData& attacker, const KingdomData& defen
 
 // Calculate trade value and acceptance chance
 bool evaluateTradeOffer(const KingdomData& offering, const KingdomData& receiving,
-                       int offerGold, int offerArmy, int reqGold, int reqArmy) {
-    // Calculate relative value of the trade
-    double offerValue = (offerGold + (offerArmy * 100)) * (1.0 + (offering.resources.morale / 200.0));
+                       int offerGold, int offerArmy, int reqGold, int reqArmy, int routeCost = 0) {
+    // Calculate relative value of the trade, less what the caravan loses on the road
+    double transportLoss = routeCost * 0.02;
+    if (transportLoss > 0.5) transportLoss = 0.5;
+    double offerValue = (offerGold + (offerArmy * 100)) * (1.0 + (offering.resources.morale / 200.0)) * (1.0 - transportLoss);
     double requestValue = (reqGold + (reqArmy * 100)) * (1.0 + (receiving.resources.morale / 200.0));
     
     // Consider kingdom's current situation
@@ -175,6 +324,7 @@ bool evaluateTradeOffer(const KingdomData& offering, const KingdomData& receivin
 // Generate dynamic AI response based on context
 string generateAIResponse(const string& sender, const string& receiver,
                          MessageType type, int trustLevel, bool isAtWar) {
+    ALLOCATION_SCOPE(SUBSYSTEM_MESSAGES);
     string response;
     
     if (isAtWar) {
@@ -216,11 +366,71 @@ string generateAIResponse(const string& sender, const string& receiver,
     return response;
 }
 
+// Multiplayer kingdoms' resources, in map order. Names and positions are
+// saved with the map
+void saveKingdoms() {
+    ofstream saveFile("kingdoms_save.txt");
+    if (saveFile.is_open()) {
+        saveFile << kingdomCount << endl;
+        for (int i = 0; i < kingdomCount; i++) {
+            const KingdomResources& r = kingdoms[i].resources;
+            saveFile << r.gold << " " << r.food << " " << r.army << " " << r.materials << " "
+                     << r.population << " " << r.morale << " " << r.happiness << endl;
+        }
+        saveFile.close();
+    }
+}
+
+// Rebuilds the kingdom list from the loaded map, so kingdoms[i] is always
+// the map's kingdom i. A kingdom without saved resources gets the ones its
+// site would give a new kingdom
+void restoreKingdoms(const MapSystem& map, AllianceSystem& alliance) {
+    ifstream loadFile("kingdoms_save.txt");
+    int savedCount = 0;
+    if (loadFile.is_open()) {
+        loadFile >> savedCount;
+    }
+    kingdomCount = map.getKingdomCount();
+    for (int i = 0; i < kingdomCount; i++) {
+        KingdomData& k = kingdoms[i];
+        k = KingdomData();
+        k.name = map.getKingdomName(i);
+        k.x = map.getPositionOf(i).x;
+        k.y = map.getPositionOf(i).y;
+        KingdomResources& r = k.resources;
+        if (i < savedCount && loadFile >> r.gold >> r.food >> r.army >> r.materials
+                                       >> r.population >> r.morale >> r.happiness) {
+            continue;
+        }
+        calculateInitialStats(k, k.x, k.y, map);
+    }
+    for (int i = kingdomCount; i < MAX_KINGDOMS; i++) {
+        leaderboards.remove(i);
+    }
+    // Ages are not saved; the loaded kingdoms start on a typical pyramid
+    memset(kingdomCohorts, 0, sizeof(kingdomCohorts));
+    // Alliances are saved by name; wars are not saved at all
+    for (int i = 0; i < MAX_KINGDOMS; i++) {
+        for (int j = 0; j < MAX_KINGDOMS; j++) {
+            alliances[i][j] = i != j && i < kingdomCount && j < kingdomCount &&
+                              alliance.areAllied(kingdoms[i].name, kingdoms[j].name);
+            wars[i][j] = false;
+        }
+    }
+    for (int i = 0; i < kingdomCount; i++) {
+        kingdomChanged(i);
+    }
+    activeKingdomIndex = 0;
+}
+
 // Saves all the game data to a file, kinda like a save point
 void saveGameState(const Population& pop, const Army& army, const Economy& eco, 
                   const ResourceManager& res, const Bank& bank,
                   const CommunicationSystem& comm, const AllianceSystem& alliance,
                   const TradeSystem& trade, const MapSystem& map) {
+    TRACE_SCOPE("saveGameState");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
+    MetricTimer saveTimer(METRIC_SAVE_SECONDS);
     ofstream saveFile("game_state.txt");
     if (saveFile.is_open()) {
         // Save population data
@@ -248,6 +458,7 @@ void saveGameState(const Population& pop, const Army& army, const Economy& eco,
         alliance.saveAlliancesToFile();
         trade.saveTradesToFile();
         map.saveMapToFile();
+        saveKingdoms();
         
         saveFile.close();
         cout << "\nGame saved successfully.\n";
@@ -261,6 +472,9 @@ void loadGameState(Population& pop, Army& army, Economy& eco,
                   ResourceManager& res, Bank& bank,
                   CommunicationSystem& comm, AllianceSystem& alliance,
                   TradeSystem& trade, MapSystem& map) {
+    TRACE_SCOPE("loadGameState");
+    ALLOCATION_SCOPE(SUBSYSTEM_SAVE_LOAD);
+    MetricTimer loadTimer(METRIC_LOAD_SECONDS);
     ifstream loadFile("game_state.txt");
     if (loadFile.is_open()) {
         string line;
@@ -285,6 +499,7 @@ void loadGameState(Population& pop, Army& army, Economy& eco,
         pop.setNobleCount(values[3]);
         pop.setHappiness(values[4]);
         pop.setFoodReserves(values[5]);
+        pop.rebuildCohorts();
         
         // Restore army
         army.setSoldierCount(values[6]);
@@ -311,6 +526,7 @@ void loadGameState(Population& pop, Army& army, Economy& eco,
         alliance.loadAlliancesFromFile();
         trade.loadTradesFromFile();
         map.loadMapFromFile();
+        restoreKingdoms(map, alliance);
         
         loadFile.close();
         cout << "\nGame loaded successfully.\n";
@@ -322,9 +538,10 @@ void loadGameState(Population& pop, Army& army, Economy& eco,
 // --- Multiplayer Management Menu ---
 void multiplayerManagementMenu(Kingdom& playerKingdom, Population& realmCitizens, 
                              Army& realmForces, Economy& realmEconomy, 
-                             WarSystem& warSystem, MapSystem& mapSystem) {
+                             WarSystem& warSystem, MapSystem& mapSystem, EventManager& events) {
+    ALLOCATION_SCOPE(SUBSYSTEM_KINGDOMS);
     int choice;
-    KingdomData k;  // For new kingdom creation
+    KingdomData k = {};  // For new kingdom creation
     int selectedKingdom = -1; // Index of currently selected kingdom
     do {
         cout << "\n=== Kingdom Management Menu ===" << endl;
@@ -344,79 +561,95 @@ void multiplayerManagementMenu(Kingdom& playerKingdom, Population& realmCitizens
                 cout << "\n=== Kingdom Creation ===" << endl;
                 cout << "Enter kingdom name: ";
                 getline(cin, k.name);
-                // Show current map
-                cout << "\nCurrent Map:\n";
-                string map[4][4];
-                for (int i = 0; i < 4; ++i) for (int j = 0; j < 4; ++j) map[i][j] = "..";
-                for (int i = 0; i < kingdomCount; ++i) {
-                    string abbr = kingdoms[i].name.substr(0,2);
-                    map[kingdoms[i].y][kingdoms[i].x] = abbr;
+                // Show current map around the best free site
+                MapPosition suggested;
+                bool haveSuggestion = mapSystem.suggestSite(2, suggested);
+                if (haveSuggestion) {
+                    mapSystem.displayMapAround(suggested.x, suggested.y, false);
+                } else {
+                    mapSystem.displayMap(0, 0, false);
                 }
-                for (int y = 0; y < 4; ++y) {
-                    cout << "| ";
-                    for (int x = 0; x < 4; ++x) cout << map[y][x] << " | ";
-                    cout << "\n";
+                if (haveSuggestion) {
+                    cout << "Suggested site: (" << suggested.x << "," << suggested.y << "), "
+                         << mapSystem.regionAround(REGION_YIELD, suggested.x, suggested.y, 2) << " yield nearby\n";
                 }
-                cout << "+-------------------+\n";
-                cout << "Choose X coordinate (0-3): ";
+                cout << "Choose X coordinate (0-" << mapSystem.getWidth() - 1 << "): ";
                 cin >> k.x;
-                cout << "Choose Y coordinate (0-3): ";
+                cout << "Choose Y coordinate (0-" << mapSystem.getHeight() - 1 << "): ";
                 cin >> k.y;
                 // Validate coordinates
-                if (k.x < 0 || k.x > 3 || k.y < 0 || k.y > 3) {
-                    cout << "Invalid coordinates! Please use values between 0 and 3.\n";
+                if (k.x < 0 || k.x >= mapSystem.getWidth() || k.y < 0 || k.y >= mapSystem.getHeight()) {
+                    cout << "Invalid coordinates! Please use values between 0 and " << mapSystem.getWidth() - 1 << ".\n";
                     break;
                 }
-                // Check if position is already occupied
-                bool positionOccupied = false;
-                for (int i = 0; i < kingdomCount; i++) {
-                    if (kingdoms[i].x == k.x && kingdoms[i].y == k.y) {
-                        positionOccupied = true;
-                        break;
-                    }
+                if (!mapSystem.getTerrain(k.x, k.y).settleable) {
+                    cout << "Nobody can settle on " << mapSystem.getTerrain(k.x, k.y).name << "! Please choose another position.\n";
+                    break;
                 }
-                if (positionOccupied) {
+                // The map knows every seat, including loaded ones
+                if (mapSystem.isOccupied(k.x, k.y)) {
                     cout << "This position is already occupied! Please choose another position.\n";
                     break;
                 }
-                // Let player set initial resources
-                cout << "\nSet your kingdom's initial resources:\n";
-                cout << "Enter initial population (1000-5000): ";
-                cin >> k.resources.population;
-                if (k.resources.population < 1000) k.resources.population = 1000;
-                if (k.resources.population > 5000) k.resources.population = 5000;
-                int recommendedArmy = calculateRecommendedArmy(k.resources.population);
-                cout << "Recommended army size: " << recommendedArmy << "\n";
-                cout << "Enter initial army size (" << recommendedArmy/2 << "-" << recommendedArmy*2 << "): ";
-                cin >> k.resources.army;
-                if (k.resources.army < recommendedArmy/2) k.resources.army = recommendedArmy/2;
-                if (k.resources.army > recommendedArmy*2) k.resources.army = recommendedArmy*2;
-                cout << "Enter initial gold (1000-10000): ";
-                cin >> k.resources.gold;
-                if (k.resources.gold < 1000) k.resources.gold = 1000;
-                if (k.resources.gold > 10000) k.resources.gold = 10000;
-                cout << "Enter initial morale (50-100): ";
-                cin >> k.resources.morale;
-                if (k.resources.morale < 50) k.resources.morale = 50;
-                if (k.resources.morale > 100) k.resources.morale = 100;
-                cout << "Enter initial happiness (50-100): ";
-                cin >> k.resources.happiness;
-                if (k.resources.happiness < 50) k.resources.happiness = 50;
-                if (k.resources.happiness > 100) k.resources.happiness = 100;
+                // The site decides the starting stats; the player may set
+                // their own instead
+                calculateInitialStats(k, k.x, k.y, mapSystem);
+                cout << "\nThis site supports " << k.resources.population << " citizens, an army of "
+                     << k.resources.army << " (morale " << k.resources.morale << "%), "
+                     << k.resources.gold << " gold and " << k.resources.happiness << "% happiness.\n";
+                cout << "Found the kingdom with these resources? (y/n): ";
+                char useSite;
+                cin >> useSite;
+                if (useSite != 'y' && useSite != 'Y') {
+                    cout << "\nSet your kingdom's initial resources:\n";
+                    cout << "Enter initial population (1000-5000): ";
+                    cin >> k.resources.population;
+                    if (k.resources.population < 1000) k.resources.population = 1000;
+                    if (k.resources.population > 5000) k.resources.population = 5000;
+                    int recommendedArmy = calculateRecommendedArmy(k.resources.population);
+                    cout << "Recommended army size: " << recommendedArmy << "\n";
+                    cout << "Enter initial army size (" << recommendedArmy/2 << "-" << recommendedArmy*2 << "): ";
+                    cin >> k.resources.army;
+                    if (k.resources.army < recommendedArmy/2) k.resources.army = recommendedArmy/2;
+                    if (k.resources.army > recommendedArmy*2) k.resources.army = recommendedArmy*2;
+                    cout << "Enter initial gold (1000-10000): ";
+                    cin >> k.resources.gold;
+                    if (k.resources.gold < 1000) k.resources.gold = 1000;
+                    if (k.resources.gold > 10000) k.resources.gold = 10000;
+                    cout << "Enter initial morale (50-100): ";
+                    cin >> k.resources.morale;
+                    if (k.resources.morale < 50) k.resources.morale = 50;
+                    if (k.resources.morale > 100) k.resources.morale = 100;
+                    cout << "Enter initial happiness (50-100): ";
+                    cin >> k.resources.happiness;
+                    if (k.resources.happiness < 50) k.resources.happiness = 50;
+                    if (k.resources.happiness > 100) k.resources.happiness = 100;
+                }
                 cout << "\nKingdom Statistics:\n";
                 cout << "Population: " << k.resources.population << "\n";
                 cout << "Army Size: " << k.resources.army << " (Morale: " << k.resources.morale << "%)\n";
                 cout << "Gold: " << k.resources.gold << "\n";
                 cout << "Happiness: " << k.resources.happiness << "%\n";
-                // Add to kingdoms array
+                // Place it on the map, then add it under the same index
+                if (kingdomCount != mapSystem.getKingdomCount() ||
+                    !mapSystem.initializeKingdom(k.name, k.x, k.y)) {
+                    cout << "Kingdom " << k.name << " could not be founded.\n";
+                    break;
+                }
                 kingdoms[kingdomCount] = k;
+                memset(kingdomCohorts[kingdomCount], 0, sizeof(kingdomCohorts[kingdomCount]));
                 kingdomCount++;
-                cout << "\nKingdom " << k.name << " created at position (" << k.x << "," << k.y << ").\n";
+                kingdomChanged(kingdomCount - 1);
+                updateMapLayers(mapSystem);
+                publishLiveStats();
+                cout << "\nKingdom " << k.name << " created at position (" << k.x << "," << k.y << ") on "
+                     << mapSystem.getTerrain(k.x, k.y).name << ".\n";
                 // Register with war system
                 Army defaultArmy;
                 defaultArmy.setSoldierCount(k.resources.army);
                 defaultArmy.setMorale(k.resources.morale);
                 warSystem.registerKingdom(k.name, defaultArmy);
+                events.scheduleKingdoms(kingdomCount);
                 selectedKingdom = kingdomCount - 1;
                 break;
             }
@@ -449,12 +682,35 @@ void multiplayerManagementMenu(Kingdom& playerKingdom, Population& realmCitizens
                 for (int i = 0; i < kingdomCount; ++i) {
                     cout << "\nKingdom: " << kingdoms[i].name << "\n";
                     cout << "Position: (" << kingdoms[i].x << "," << kingdoms[i].y << ")\n";
-                    cout << "Population: " << kingdoms[i].resources.population << "\n";
-                    cout << "Army Size: " << kingdoms[i].resources.army << " (Morale: " << kingdoms[i].resources.morale << "%)\n";
-                    cout << "Gold: " << kingdoms[i].resources.gold << "\n";
+                    cout << "Population: " << kingdoms[i].resources.population
+                         << " (#" << leaderboards.rankOf(RANK_POPULATION, i) << ")\n";
+                    cout << "Army Size: " << kingdoms[i].resources.army << " (Morale: " << kingdoms[i].resources.morale
+                         << "%, #" << leaderboards.rankOf(RANK_ARMY, i) << ")\n";
+                    cout << "Gold: " << kingdoms[i].resources.gold << " (#" << leaderboards.rankOf(RANK_GOLD, i) << ")\n";
                     cout << "Happiness: " << kingdoms[i].resources.happiness << "%\n";
+                    cout << "Territory: " << mapSystem.getTerritorySize(i) << " tiles, border "
+                         << mapSystem.getBorderLength(i) << "\n";
+                    for (int j = 0; j < kingdomCount; ++j) {
+                        if (j != i && mapSystem.areNeighbours(i, j)) {
+                            cout << "Borders: " << kingdoms[j].name << "\n";
+                        }
+                    }
                     cout << "----------------------------------------\n";
                 }
+                cout << "\nWorld: " << worldTotals.get(RANK_POPULATION) << " citizens, "
+                     << worldTotals.get(RANK_ARMY) << " soldiers, " << worldTotals.get(RANK_GOLD) << " gold\n";
+                cout << "\n=== Leaderboards ===\n";
+                const int shownResources[] = { RANK_GOLD, RANK_ARMY, RANK_POPULATION };
+                for (int r = 0; r < 3; ++r) {
+                    int leaders[3];
+                    int shown = leaderboards.top(shownResources[r], 3, leaders);
+                    cout << KingdomLeaderboards::resourceName(shownResources[r]) << ":";
+                    for (int j = 0; j < shown; ++j) {
+                        cout << " " << j + 1 << ". " << kingdoms[leaders[j]].name << " ("
+                             << KingdomLeaderboards::valueOf(shownResources[r], kingdoms[leaders[j]].resources) << ")";
+                    }
+                    cout << "\n";
+                }
                 break;
             }
             case 4:
@@ -464,31 +720,25 @@ void multiplayerManagementMenu(Kingdom& playerKingdom, Population& realmCitizens
         }
 
         // Map after each action (always show)
-        cout << "\nCurrent Map:\n";
-        string map[4][4];
-        for (int i = 0; i < 4; ++i) for (int j = 0; j < 4; ++j) map[i][j] = "..";
-        for (int i = 0; i < kingdomCount; ++i) {
-            string abbr = kingdoms[i].name.substr(0,2);
-            map[kingdoms[i].y][kingdoms[i].x] = abbr;
-        }
-        for (int y = 0; y < 4; ++y) {
-            cout << "| ";
-            for (int x = 0; x < 4; ++x) cout << map[y][x] << " | ";
-            cout << "\n";
+        if (selectedKingdom >= 0) {
+            mapSystem.displayMapAround(kingdoms[selectedKingdom].x, kingdoms[selectedKingdom].y, false);
+        } else {
+            mapSystem.displayMap(0, 0, false);
         }
-        cout << "+-------------------+\n";
     } while (choice != 4);
 }
 
 // Multiplayer Actions Menu 
 void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem,
-                          CommunicationSystem& commSystem) {
+                          CommunicationSystem& commSystem, TradeSystem& tradeSystem,
+                          EpidemicSystem& epidemic, MapSystem& mapSystem, EventManager& events) {
     while (true) {
         if (kingdomCount == 0) {
             cout << "\nNo kingdoms in multiplayer mode! Please create or join a kingdom first.\n";
             return;
         }
 
+        publishLiveStats();
         KingdomData& activeKingdom = kingdoms[activeKingdomIndex];
         cout << "\n===============================\n";
         cout << "       MULTIPLAYER ACTIONS\n";
@@ -510,9 +760,11 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
         cout << "9. Move on Map\n";
         cout << "10. View Map\n";
         cout << "11. End Turn\n";
-        cout << "12. Return to Main Menu\n";
+        cout << "12. Smuggle Gold\n";
+        cout << "13. Return to Main Menu\n";
         cout << "Enter your choice: ";
         int choice; cin >> choice;
+        AllocationScope choiceScope(choice >= 1 && choice <= 13 ? ACTION_SUBSYSTEM[choice] : SUBSYSTEM_OTHER);
         
         if (choice == 1) {
             cout << "\nCurrent alliances:\n";
@@ -526,8 +778,12 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
             }
             if (!found) cout << "None\n";
         } else if (choice == 2) {
-            cout << "\nAvailable kingdoms for alliance:\n";
-            for (int i = 0; i < kingdomCount; ++i) {
+            // Neighbours are listed first; they can come to each other's aid soonest
+            cout << "\nAvailable kingdoms for alliance, nearest first:\n";
+            vector<int> nearby;
+            mapSystem.getNearestKingdoms(activeKingdom.x, activeKingdom.y, kingdomCount, nearby);
+            for (size_t n = 0; n < nearby.size(); ++n) {
+                int i = nearby[n];
                 if (i != activeKingdomIndex && !alliances[activeKingdomIndex][i]) {
                     cout << "- " << kingdoms[i].name << "\n";
                     cout << "  Population: " << kingdoms[i].resources.population << "\n";
@@ -579,7 +835,10 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
                     }
                 }
                 
-                if (shouldAccept) {
+                // The alliance system keeps the trust, and refuses once its ledger is full
+                if (shouldAccept && !allianceSystem.formAlliance(kingdoms[activeKingdomIndex].name, kingdoms[idx].name)) {
+                    cout << "\nThe alliance could not be sealed.\n";
+                } else if (shouldAccept) {
                     alliances[activeKingdomIndex][idx] = alliances[idx][activeKingdomIndex] = true;
                     allianceSystem.updateTrustLevel(kingdoms[activeKingdomIndex].name, kingdoms[idx].name, 20);
                     cout << "\n" << kingdoms[idx].name << " has accepted your alliance proposal!\n";
@@ -616,8 +875,8 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
                 cout << "No alliance exists!\n";
             } else {
                 alliances[activeKingdomIndex][idx] = alliances[idx][activeKingdomIndex] = false;
+                allianceSystem.breakAlliance(activeKingdom.name, kingdoms[idx].name);
                 allianceSystem.updateTrustLevel(activeKingdom.name, kingdoms[idx].name, -30);
-                cout << "\nAlliance broken with " << kingdoms[idx].name << ".\n";
                 cout << "Trust level decreased by 30%.\n";
             }
         } else if (choice == 4) {
@@ -631,13 +890,26 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
             }
             if (!found) cout << "None\n";
         } else if (choice == 5) {
-            cout << "\nAvailable kingdoms for war:\n";
+            cout << "\nAvailable kingdoms for war (~ marks a scout's estimate):\n";
             for (int i = 0; i < kingdomCount; ++i) {
                 if (i != activeKingdomIndex && !wars[activeKingdomIndex][i]) {
+                    bool seen = canSeeKingdom(mapSystem, activeKingdomIndex, i);
                     cout << "- " << kingdoms[i].name << "\n";
-                    cout << "  Army: " << kingdoms[i].resources.army << " (Morale: " << kingdoms[i].resources.morale << "%)\n";
-                    cout << "  Gold: " << kingdoms[i].resources.gold << "\n";
-                    cout << "  Population: " << kingdoms[i].resources.population << "\n";
+                    cout << "  Army: " << scoutReport(kingdoms[i].resources.army, seen)
+                         << " (Morale: " << (seen ? to_string(kingdoms[i].resources.morale) : string("?")) << "%)\n";
+                    cout << "  Gold: " << scoutReport(kingdoms[i].resources.gold, seen) << "\n";
+                    cout << "  Population: " << scoutReport(kingdoms[i].resources.population, seen) << "\n";
+                }
+            }
+            // Scouts point at the weakest army they can actually see
+            int ranked[MAX_KINGDOMS];
+            int rankedCount = leaderboards.top(RANK_ARMY, kingdomCount, ranked);
+            for (int r = rankedCount - 1; r >= 0; --r) {
+                int i = ranked[r];
+                if (i != activeKingdomIndex && !wars[activeKingdomIndex][i] && !alliances[activeKingdomIndex][i] &&
+                    canSeeKingdom(mapSystem, activeKingdomIndex, i)) {
+                    cout << "Scouts suggest: " << kingdoms[i].name << "\n";
+                    break;
                 }
             }
             
@@ -646,17 +918,36 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
             int idx = -1;
             for (int i = 0; i < kingdomCount; ++i) if (kingdoms[i].name == target) idx = i;
             
+            int marchTurns = (idx == -1) ? -1 : mapSystem.getMarchTurns(activeKingdomIndex, idx);
             if (idx == -1 || idx == activeKingdomIndex) {
                 cout << "Invalid kingdom!\n";
             } else if (wars[activeKingdomIndex][idx]) {
                 cout << "Already at war!\n";
+            } else if (marchTurns < 0) {
+                cout << "Your army has no way over land to " << kingdoms[idx].name << "!\n";
             } else {
                 // Get the active and target kingdom resources
                 const KingdomResources& attackerRes = kingdoms[activeKingdomIndex].resources;
                 const KingdomResources& defenderRes = kingdoms[idx].resources;
+
+                // Allies march on the same target, so they share one flow field.
+                // Those that arrive no later than the main host send a quarter
+                // of their army along
+                int alliedSoldiers = 0;
+                const FlowField& toTarget = mapSystem.getFlowField(kingdoms[idx].x, kingdoms[idx].y);
+                for (int i = 0; i < kingdomCount; ++i) {
+                    if (i == activeKingdomIndex || i == idx || !alliances[activeKingdomIndex][i]) continue;
+                    int cost = toTarget.costAt(kingdoms[i].x, kingdoms[i].y);
+                    if (cost < 0) continue;
+                    int allyTurns = (cost + ARMY_MARCH_PER_TURN - 1) / ARMY_MARCH_PER_TURN;
+                    if (allyTurns <= marchTurns) {
+                        alliedSoldiers += kingdoms[i].resources.army / 4;
+                        cout << kingdoms[i].name << " joins the attack, arriving in " << allyTurns << " turn(s).\n";
+                    }
+                }
                 
-                // Calculate relative strengths
-                double armyRatio = (double)attackerRes.army / defenderRes.army;
+                // Calculate relative strengths; every turn on the march costs 5%
+                double armyRatio = (double)(attackerRes.army + alliedSoldiers) / defenderRes.army / (1.0 + 0.05 * marchTurns);
                 double goldRatio = (double)attackerRes.gold / defenderRes.gold;
                 double moraleRatio = (double)attackerRes.morale / defenderRes.morale;
                 
@@ -666,10 +957,20 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
                 // Declare war
                 wars[activeKingdomIndex][idx] = wars[idx][activeKingdomIndex] = true;
                 warSystem.declareWar(kingdoms[activeKingdomIndex].name, kingdoms[idx].name, 
-                                   warSystem.getKingdomArmy(kingdoms[activeKingdomIndex].name));
+                                   warSystem.getKingdomArmy(kingdoms[activeKingdomIndex].name), marchTurns);
                 
                 cout << "\n=== War Declared ===\n";
-                cout << kingdoms[activeKingdomIndex].name << " has declared war on " << kingdoms[idx].name << "!\n\n";
+                cout << kingdoms[activeKingdomIndex].name << " has declared war on " << kingdoms[idx].name << "!\n";
+
+                // The host camps halfway along its road before the battle
+                vector<MapPosition> marchRoute;
+                if (mapSystem.findRoute(kingdoms[activeKingdomIndex].x, kingdoms[activeKingdomIndex].y,
+                                        kingdoms[idx].x, kingdoms[idx].y, marchRoute) >= 0) {
+                    const MapPosition& camp = marchRoute[marchRoute.size() / 2];
+                    cout << "The army marches " << marchRoute.size() - 1 << " tiles, camping at ("
+                         << camp.x << "," << camp.y << ") on the way.\n";
+                }
+                cout << "\n";
                 
                 // Battle Outcome
                 string outcome;
@@ -708,6 +1009,7 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
                 }
                 
                 // Apply battle consequences
+                Metrics::increment(METRIC_BATTLES);
                 if (attackerWins) {
                     // Attacker gains
                     kingdoms[activeKingdomIndex].resources.morale += 15;
@@ -745,6 +1047,8 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
                     cout << "- 20% of their army\n";
                     cout << "- 15% morale\n";
                 }
+                kingdomChanged(activeKingdomIndex);
+                kingdomChanged(idx);
             }
         } else if (choice == 6) {
             cout << "\nCurrent wars:\n";
@@ -812,14 +1116,15 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
                 cout << "\nResponse from " << recipient << ": " << response << "\n";
             }
         } else if (choice == 8) {
-            cout << "\nAvailable kingdoms for trade:\n";
+            cout << "\nAvailable kingdoms for trade (~ marks a scout's estimate):\n";
             for (int i = 0; i < kingdomCount; ++i) {
                 if (i != activeKingdomIndex) {
+                    bool seen = canSeeKingdom(mapSystem, activeKingdomIndex, i);
                     cout << "- " << kingdoms[i].name << "\n";
-                    cout << "  Gold: " << kingdoms[i].resources.gold << "\n";
-                    cout << "  Food: " << kingdoms[i].resources.population << "\n";
-                    cout << "  Army: " << kingdoms[i].resources.army << "\n";
-                    cout << "  Materials: " << kingdoms[i].resources.population << "\n";
+                    cout << "  Gold: " << scoutReport(kingdoms[i].resources.gold, seen) << "\n";
+                    cout << "  Food: " << scoutReport(kingdoms[i].resources.population, seen) << "\n";
+                    cout << "  Army: " << scoutReport(kingdoms[i].resources.army, seen) << "\n";
+                    cout << "  Materials: " << scoutReport(kingdoms[i].resources.population, seen) << "\n";
                 }
             }
             
@@ -832,6 +1137,14 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
                 cout << "Invalid kingdom!\n";
                 continue;
             }
+            int routeCost = mapSystem.getRouteCost(activeKingdomIndex, idx);
+            if (routeCost < 0) {
+                cout << "No caravan route leads to " << kingdoms[idx].name << "!\n";
+                continue;
+            }
+            // Caravans lose 2% of the goods per point of route cost, up to half
+            int lostPercent = routeCost * 2 > 50 ? 50 : routeCost * 2;
+            cout << "Caravan route cost: " << routeCost << " (" << lostPercent << "% of your goods lost on the way)\n";
             
             cout << "\nYour Resources:\n";
             cout << "Gold: " << activeKingdom.resources.gold << "\n";
@@ -839,11 +1152,12 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
             cout << "Army: " << activeKingdom.resources.army << "\n";
             cout << "Materials: " << activeKingdom.resources.population << "\n";
             
+            bool seen = canSeeKingdom(mapSystem, activeKingdomIndex, idx);
             cout << "\nTheir Resources:\n";
-            cout << "Gold: " << kingdoms[idx].resources.gold << "\n";
-            cout << "Food: " << kingdoms[idx].resources.population << "\n";
-            cout << "Army: " << kingdoms[idx].resources.army << "\n";
-            cout << "Materials: " << kingdoms[idx].resources.population << "\n";
+            cout << "Gold: " << scoutReport(kingdoms[idx].resources.gold, seen) << "\n";
+            cout << "Food: " << scoutReport(kingdoms[idx].resources.population, seen) << "\n";
+            cout << "Army: " << scoutReport(kingdoms[idx].resources.army, seen) << "\n";
+            cout << "Materials: " << scoutReport(kingdoms[idx].resources.population, seen) << "\n";
             
             cout << "\nEnter your offer:\n";
             KingdomResources offering, requesting;
@@ -862,9 +1176,11 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
             cout << "\nSend this trade offer? (y/n): ";
             char yn; cin >> yn;
             if (yn == 'y' || yn == 'Y') {
-                bool accepted = isTradeFavorable(offering, requesting, activeKingdom.resources);
+                bool accepted = isTradeFavorable(offering, requesting, activeKingdom.resources, routeCost);
+                Metrics::increment(METRIC_TRADES_OFFERED);
                 
                 if (accepted) {
+                    Metrics::increment(METRIC_TRADES_MATCHED);
                     // Execute trade
                     activeKingdom.resources.gold -= offering.gold;
                     activeKingdom.resources.gold += requesting.gold;
@@ -875,20 +1191,27 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
                     activeKingdom.resources.population -= offering.materials;
                     activeKingdom.resources.population += requesting.materials;
                     
+                    // Only what survives the road reaches the other kingdom
+                    int keptPercent = 100 - lostPercent;
                     kingdoms[idx].resources.gold -= requesting.gold;
-                    kingdoms[idx].resources.gold += offering.gold;
+                    kingdoms[idx].resources.gold += offering.gold * keptPercent / 100;
                     kingdoms[idx].resources.population -= requesting.food;
-                    kingdoms[idx].resources.population += offering.food;
+                    kingdoms[idx].resources.population += offering.food * keptPercent / 100;
                     kingdoms[idx].resources.army -= requesting.army;
-                    kingdoms[idx].resources.army += offering.army;
+                    kingdoms[idx].resources.army += offering.army * keptPercent / 100;
                     kingdoms[idx].resources.population -= requesting.materials;
-                    kingdoms[idx].resources.population += offering.materials;
+                    kingdoms[idx].resources.population += offering.materials * keptPercent / 100;
+                    kingdomChanged(activeKingdomIndex);
+                    kingdomChanged(idx);
                     
                     cout << "\n" << kingdoms[idx].name << " has accepted your trade offer!\n";
                     cout << "Trade completed successfully.\n";
                     
                     // Increase trust between kingdoms
                     allianceSystem.updateTrustLevel(activeKingdom.name, kingdoms[idx].name, 5);
+                    
+                    // Caravans now travel between the two cities, and so can disease
+                    epidemic.addTradeLink(activeKingdom.x, activeKingdom.y, kingdoms[idx].x, kingdoms[idx].y, 0.05f);
                 } else {
                     cout << "\n" << kingdoms[idx].name << " has rejected your trade offer.\n";
                     cout << "They found the terms unfavorable.\n";
@@ -899,39 +1222,79 @@ void multiplayerActionsMenu(WarSystem& warSystem, AllianceSystem& allianceSystem
             }
         } else if (choice == 9) {
             cout << "Current position: (" << activeKingdom.x << "," << activeKingdom.y << ")\n";
-            cout << "Enter new X coordinate (0–3): "; int nx; cin >> nx;
-            cout << "Enter new Y coordinate (0–3): "; int ny; cin >> ny;
-            activeKingdom.x = nx; activeKingdom.y = ny;
-            ofstream log("map_log.txt", ios::app);
-            log << activeKingdom.name << " moved to (" << nx << "," << ny << ")" << endl;
-            log.close();
-            cout << "\nKingdom " << activeKingdom.name << " moved to (" << nx << "," << ny << ").\nUpdated in: map_log.txt\n";
-        } else if (choice == 10) {
-            cout << "Current Map:\n+-------------------+\n";
-            string map[4][4] = {".."};
-            for (int i = 0; i < 4; ++i) for (int j = 0; j < 4; ++j) map[i][j] = "..";
-            for (int i = 0; i < kingdomCount; ++i) {
-                string abbr = kingdoms[i].name.substr(0,2);
-                map[kingdoms[i].y][kingdoms[i].x] = abbr;
+            cout << "Enter new X coordinate (0-" << mapSystem.getWidth() - 1 << "): "; int nx; cin >> nx;
+            cout << "Enter new Y coordinate (0-" << mapSystem.getHeight() - 1 << "): "; int ny; cin >> ny;
+            // The map checks the bounds, the terrain and the way there, and logs the move
+            if (mapSystem.moveKingdom(activeKingdom.name, nx, ny)) {
+                activeKingdom.x = nx; activeKingdom.y = ny;
+                cout << "\nKingdom " << activeKingdom.name << " moved to (" << nx << "," << ny << ").\nUpdated in: map_log.txt\n";
             }
-            for (int y = 0; y < 4; ++y) {
-                cout << "| ";
-                for (int x = 0; x < 4; ++x) cout << map[y][x] << " | ";
-                cout << "\n";
-            }
-            cout << "+-------------------+\n\nLegend:\n";
-            for (int i = 0; i < kingdomCount; ++i) {
-                cout << kingdoms[i].name.substr(0,2) << " - " << kingdoms[i].name << " (" << kingdoms[i].x << "," << kingdoms[i].y << ")\n";
+        } else if (choice == 10) {
+            // The window is kept on the map here too, so scrolling back
+            // from an edge moves the view on the first key
+            int maxViewX = mapSystem.getWidth() - MAP_VIEW_WIDTH;
+            int maxViewY = mapSystem.getHeight() - MAP_VIEW_HEIGHT;
+            int viewX = activeKingdom.x - MAP_VIEW_WIDTH / 2;
+            int viewY = activeKingdom.y - MAP_VIEW_HEIGHT / 2;
+            while (true) {
+                if (viewX > maxViewX) viewX = maxViewX;
+                if (viewY > maxViewY) viewY = maxViewY;
+                if (viewX < 0) viewX = 0;
+                if (viewY < 0) viewY = 0;
+                mapSystem.displayMap(viewX, viewY);
+                // Maps bigger than the window can be scrolled
+                if (maxViewX <= 0 && maxViewY <= 0) break;
+                cout << "Scroll with w/a/s/d, q to close the map: ";
+                char key = 'q'; cin >> key;
+                if (key == 'w') viewY -= MAP_VIEW_HEIGHT / 2;
+                else if (key == 's') viewY += MAP_VIEW_HEIGHT / 2;
+                else if (key == 'a') viewX -= MAP_VIEW_WIDTH / 2;
+                else if (key == 'd') viewX += MAP_VIEW_WIDTH / 2;
+                else break;
             }
         } else if (choice == 11) {
             cout << "End turn for " << activeKingdom.name << "? (y/n): ";
             char yn; cin >> yn;
             if (yn == 'y' || yn == 'Y') {
-                activeKingdomIndex = (activeKingdomIndex + 1) % kingdomCount;
+                advanceTurn(mapSystem, epidemic, events);
                 cout << "\nNow controlling: " << kingdoms[activeKingdomIndex].name << "\n";
                 break;
             }
         } else if (choice == 12) {
+            cout << "\nKingdoms to smuggle gold into:\n";
+            for (int i = 0; i < kingdomCount; ++i) {
+                if (i != activeKingdomIndex) cout << "- " << kingdoms[i].name << "\n";
+            }
+            cout << "\nEnter kingdom name: ";
+            string target; cin.ignore(); getline(cin, target);
+            int idx = -1;
+            for (int i = 0; i < kingdomCount; ++i) if (kingdoms[i].name == target) idx = i;
+
+            if (idx == -1 || idx == activeKingdomIndex) {
+                cout << "Invalid kingdom!\n";
+                continue;
+            }
+            int routeCost = mapSystem.getRouteCost(activeKingdomIndex, idx);
+            if (routeCost < 0) {
+                cout << "No smuggling route leads to " << kingdoms[idx].name << "!\n";
+                continue;
+            }
+            cout << "Gold to smuggle: ";
+            int amount; cin >> amount;
+            if (amount <= 0 || amount > activeKingdom.resources.gold) {
+                cout << "Not enough gold in treasury!\n";
+                continue;
+            }
+            // An ally's border guards look the other way more often
+            int risk = alliances[activeKingdomIndex][idx] ? 15 : 30;
+            int delivered = tradeSystem.executeSmuggling(kingdoms[idx].name, amount, risk, routeCost);
+            if (delivered >= 0) {
+                activeKingdom.resources.gold -= amount;
+                kingdoms[idx].resources.gold += delivered;
+                kingdomChanged(activeKingdomIndex);
+                kingdomChanged(idx);
+            }
+        } else if (choice == 13) {
             break;
         } else {
             cout << "Invalid choice!\n";
@@ -953,9 +1316,15 @@ struct TradeValue {
 };
 
 // Calculate if a trade is favorable
-bool isTradeFavorable(const KingdomResources& offering, const KingdomResources& requesting, const KingdomResources& kingdom) {
+bool isTradeFavorable(const KingdomResources& offering, const KingdomResources& requesting, const KingdomResources& kingdom,
+                      int routeCost) {
     // Calculate total value of offered resources
     int offeredValue = offering.gold + (offering.food * 2) + (offering.army * 3) + (offering.materials * 1.5);
+
+    // Goods lose 2% of their value per point of caravan route cost, up to half
+    double transportLoss = routeCost * 0.02;
+    if (transportLoss > 0.5) transportLoss = 0.5;
+    offeredValue *= (1.0 - transportLoss);
     
     // Calculate total value of requested resources
     int requestedValue = requesting.gold + (requesting.food * 2) + (requesting.army * 3) + (requesting.materials * 1.5);
@@ -969,7 +1338,9 @@ bool isTradeFavorable(const KingdomResources& offering, const KingdomResources&
     return (offeredValue * needMultiplier) >= requestedValue;
 }
 
-int main() {
+// benchmark.cpp brings its own main when built with STRONGHOLD_BENCHMARK
+#ifndef STRONGHOLD_BENCHMARK
+int main(int argc, char* argv[]) {
     ResourceManager realmResources;
     Economy realmEconomy;
     Population realmCitizens;
@@ -985,28 +1356,82 @@ int main() {
     TradeSystem tradeSystem;
     MapSystem mapSystem;
     WarSystem warSystem;
+    EpidemicSystem epidemic(mapSystem.getWidth(), mapSystem.getHeight());
+
+    // The home realm sits in the middle of the map for plague purposes
+    realmEvents.attachEpidemic(&epidemic, mapSystem.getWidth() / 2, mapSystem.getHeight() / 2);
+
+    // --tui keeps the main menu in place and redraws only what changed,
+    // --trace <file> records where each turn's time goes, --alloc-stats
+    // reports heap use per subsystem every turn and at exit, and
+    // --metrics <prefix> exports per-turn metrics every 100 turns.
+    // --live-stats [name] publishes a world summary in shared memory and
+    // --read-live-stats [name] prints the one a running game publishes.
+    // --world <width> <height> [seed] plays on a generated world instead of
+    // the classic 4x4 map
+    ScreenBuffer& screen = ScreenBuffer::console();
+    bool allocationReport = false;
+    int worldWidth = 0;
+    int worldHeight = 0;
+    unsigned int worldSeed = 0;
+    for (int i = 1; i < argc; i++) {
+        if (string(argv[i]) == "--tui") {
+            screen.setRedraw(true);
+        } else if (string(argv[i]) == "--trace" && i + 1 < argc) {
+            TraceLog::enable(argv[++i]);
+        } else if (string(argv[i]) == "--metrics" && i + 1 < argc) {
+            Metrics::enable(argv[++i], 100);
+        } else if (string(argv[i]) == "--alloc-stats") {
+            allocationReport = true;
+            AllocationStats::setTurnReports(true);
+        } else if (string(argv[i]) == "--live-stats") {
+            liveStats.open(i + 1 < argc && argv[i + 1][0] == '/' ? argv[++i] : LIVE_STATS_NAME);
+        } else if (string(argv[i]) == "--read-live-stats") {
+            return printLiveStats(i + 1 < argc ? argv[i + 1] : LIVE_STATS_NAME);
+        } else if (string(argv[i]) == "--world" && i + 2 < argc) {
+            worldWidth = atoi(argv[++i]);
+            worldHeight = atoi(argv[++i]);
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                worldSeed = (unsigned int)strtoul(argv[++i], 0, 10);
+            }
+        }
+    }
+
+    // Without a seed every game gets a world of its own
+    if (worldWidth > 0 && worldHeight > 0) {
+        if (worldSeed == 0) worldSeed = (unsigned int)time(0);
+        mapSystem.generateWorld(worldWidth, worldHeight, worldSeed);
+        epidemic.resize(worldWidth, worldHeight);
+        realmEvents.attachEpidemic(&epidemic, worldWidth / 2, worldHeight / 2);
+        cout << "Playing on a " << worldWidth << "x" << worldHeight << " world from seed " << worldSeed << "\n";
+    } else if (worldWidth != 0 || worldHeight != 0) {
+        cout << "A world needs a positive width and height, playing on the classic map\n";
+    }
 
     int userSelection;
     bool gameActive = true;
 
     while (gameActive) {
-        cout << "\n==================================================\n";
-        cout << "                    KINGDOM MANAGEMENT            \n";
-        cout << "==================================================\n";
-        cout << "1. Show Stats                                     \n";
-        cout << "2. Manage People                                  \n";
-        cout << "3. Manage Army                                    \n";
-        cout << "4. Manage Money                                   \n";
-        cout << "5. Get Resources                                  \n";
-        cout << "6. Random Events                                  \n";
-        cout << "7. Multiplayer Management Menu                    \n";
-        cout << "8. Multiplayer Actions Menu                       \n";
-        cout << "9. Save Game                                      \n";
-        cout << "10. Load Game                                     \n";
-        cout << "11. Exit Game                                     \n";
-        cout << "==================================================\n";
-        cout << "Enter your choice: ";
+        publishLiveStats();
+        screen << "\n==================================================\n";
+        screen << "                    KINGDOM MANAGEMENT            \n";
+        screen << "==================================================\n";
+        screen << "1. Show Stats                                     \n";
+        screen << "2. Manage People                                  \n";
+        screen << "3. Manage Army                                    \n";
+        screen << "4. Manage Money                                   \n";
+        screen << "5. Get Resources                                  \n";
+        screen << "6. Random Events / Pass Time                      \n";
+        screen << "7. Multiplayer Management Menu                    \n";
+        screen << "8. Multiplayer Actions Menu                       \n";
+        screen << "9. Save Game                                      \n";
+        screen << "10. Load Game                                     \n";
+        screen << "11. Exit Game                                     \n";
+        screen << "==================================================\n";
+        screen << "Enter your choice: ";
+        screen.presentFrame();
         cin >> userSelection;
+        screen.clearBelow();
 
         if (cin.fail() || userSelection < 1 || userSelection > 11) {
             cin.clear();
@@ -1016,14 +1441,17 @@ int main() {
         }
 
         // Handle the player's choice
+        AllocationScope menuScope(MENU_SUBSYSTEM[userSelection]);
         switch (userSelection) {
             case 1:
-                cout << "\nCurrent Stats:\n";
+                screen.hold();
+                screen << "\nCurrent Stats:\n";
                 realmCitizens.showStats();
                 realmForces.showStats();
                 realmEconomy.showStats();
                 realmResources.showStats();
                 realmTreasury.showStats();
+                screen.release();
                 break;
 
             case 2:
@@ -1096,11 +1524,11 @@ int main() {
                 break;
 
             case 7:
-                multiplayerManagementMenu(playerKingdom, realmCitizens, realmForces, realmEconomy, warSystem, mapSystem);
+                multiplayerManagementMenu(playerKingdom, realmCitizens, realmForces, realmEconomy, warSystem, mapSystem, realmEvents);
                 break;
 
             case 8:
-                multiplayerActionsMenu(warSystem, allianceSystem, commSystem);
+                multiplayerActionsMenu(warSystem, allianceSystem, commSystem, tradeSystem, epidemic, mapSystem, realmEvents);
                 break;
 
             case 9:
@@ -1108,6 +1536,10 @@ int main() {
                 saveGameState(realmCitizens, realmForces, realmEconomy,
                             realmResources, realmTreasury, commSystem,
                             allianceSystem, tradeSystem, mapSystem);
+                // The trace so far is saved alongside, it is rewritten at exit
+                if (TraceLog::isEnabled()) {
+                    TraceLog::dump();
+                }
                 break;
 
             case 10:
@@ -1115,6 +1547,21 @@ int main() {
                 loadGameState(realmCitizens, realmForces, realmEconomy,
                             realmResources, realmTreasury, commSystem,
                             allianceSystem, tradeSystem, mapSystem);
+                // The plague grid has to cover the loaded map
+                if (epidemic.getWidth() != mapSystem.getWidth() || epidemic.getHeight() != mapSystem.getHeight()) {
+                    epidemic.resize(mapSystem.getWidth(), mapSystem.getHeight());
+                    realmEvents.attachEpidemic(&epidemic, mapSystem.getWidth() / 2, mapSystem.getHeight() / 2);
+                }
+                // Loaded kingdoms need armies to go to war with
+                for (int i = 0; i < kingdomCount; i++) {
+                    if (!warSystem.isRegistered(kingdoms[i].name)) {
+                        Army loadedArmy;
+                        loadedArmy.setSoldierCount(kingdoms[i].resources.army);
+                        loadedArmy.setMorale(kingdoms[i].resources.morale);
+                        warSystem.registerKingdom(kingdoms[i].name, loadedArmy);
+                    }
+                }
+                realmEvents.scheduleKingdoms(kingdomCount);
                 break;
 
             case 11:
@@ -1124,6 +1571,10 @@ int main() {
     }
 
     delete realmRuler;
+    if (allocationReport) {
+        AllocationStats::report(cout);
+    }
     cout << "\nGame ended. Thanks for playing!\n";
     return 0;
 }
+#endif // STRONGHOLD_BENCHMARK
@@ -0,0 +1,199 @@
+#include "Stronghold.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+struct MetricInfo {
+    const char* name;
+    const char* help;
+    MetricKind kind;
+};
+
+static const MetricInfo METRIC_INFO[METRIC_COUNT] = {
+    { "stronghold_turns_total",           "Turns played",                          METRIC_COUNTER },
+    { "stronghold_turns_per_second",      "Turn rate over the last turn",          METRIC_GAUGE },
+    { "stronghold_trades_offered_total",  "Trades offered between kingdoms",       METRIC_COUNTER },
+    { "stronghold_trades_matched_total",  "Trades accepted and carried out",       METRIC_COUNTER },
+    { "stronghold_battles_total",         "Battles resolved",                      METRIC_COUNTER },
+    { "stronghold_messages_sent_total",   "Diplomatic messages sent",              METRIC_COUNTER },
+    { "stronghold_events_fired_total",    "Random events that struck the realm",   METRIC_COUNTER },
+    { "stronghold_save_seconds",          "Time taken to save the game",           METRIC_HISTOGRAM },
+    { "stronghold_load_seconds",          "Time taken to load the game",           METRIC_HISTOGRAM },
+    { "stronghold_heap_live_bytes",       "Heap bytes in use at the end of a turn", METRIC_GAUGE },
+    { "stronghold_kingdom_population",    "Citizens across all kingdoms",          METRIC_GAUGE }
+};
+
+// Upper bounds of the histogram buckets, in seconds
+static const double BUCKET_BOUNDS[METRIC_BUCKETS - 1] = { 0.0001, 0.001, 0.01, 0.1, 1.0 };
+
+double Metrics::values[METRIC_COUNT];
+double Metrics::sums[METRIC_COUNT];
+long long Metrics::buckets[METRIC_COUNT][METRIC_BUCKETS];
+double Metrics::turnStartValues[METRIC_COUNT];
+double Metrics::turnStartSums[METRIC_COUNT];
+MetricTurnSample Metrics::history[METRIC_HISTORY_TURNS];
+int Metrics::historyCount = 0;
+int Metrics::historyStart = 0;
+int Metrics::turnsClosed = 0;
+long long Metrics::lastTurnEnd = -1;
+string Metrics::filePrefix = "metrics";
+int Metrics::exportInterval = 100;
+bool Metrics::exporting = false;
+long long Metrics::runId = 0;
+
+static chrono::steady_clock::time_point metricsEpoch = chrono::steady_clock::now();
+
+long long Metrics::now() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - metricsEpoch).count();
+}
+
+// Exports every few turns, never less often than the ring can hold
+void Metrics::enable(const string& prefix, int everyTurns) {
+    if (!exporting) {
+        atexit(exportAtExit);
+    }
+    filePrefix = prefix;
+    exportInterval = everyTurns < 1 ? 1 : everyTurns > METRIC_HISTORY_TURNS ? METRIC_HISTORY_TURNS : everyTurns;
+    exporting = true;
+
+    // The CSV is appended to across runs and every run counts turns from
+    // zero, so rows carry the run's start time (in ms) to tell runs apart.
+    // A file written before the run column existed is started afresh
+    runId = chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    string csvName = filePrefix + ".csv";
+    bool hasRunColumn = false;
+    FILE* existing = fopen(csvName.c_str(), "r");
+    if (existing) {
+        char header[8];
+        hasRunColumn = fgets(header, sizeof(header), existing) != 0 && strncmp(header, "run,", 4) == 0;
+        fclose(existing);
+    }
+    if (!hasRunColumn) {
+        FILE* out = fopen(csvName.c_str(), "w");
+        if (out) {
+            fprintf(out, "run,turn");
+            for (int m = 0; m < METRIC_COUNT; m++) {
+                if (METRIC_INFO[m].kind == METRIC_HISTOGRAM) {
+                    fprintf(out, ",%s_count,%s_sum", METRIC_INFO[m].name, METRIC_INFO[m].name);
+                } else {
+                    fprintf(out, ",%s", METRIC_INFO[m].name);
+                }
+            }
+            fprintf(out, "\n");
+            fclose(out);
+        }
+    }
+}
+
+void Metrics::exportAtExit() {
+    exportNow();
+}
+
+void Metrics::observe(int metric, double seconds) {
+    values[metric] += 1;
+    sums[metric] += seconds;
+    int bucket = 0;
+    while (bucket < METRIC_BUCKETS - 1 && seconds > BUCKET_BOUNDS[bucket]) {
+        bucket++;
+    }
+    buckets[metric][bucket]++;
+}
+
+// Closes the turn's sample. When the ring is full the oldest sample is
+// overwritten, which only happens if exporting is off
+void Metrics::endTurn(int turnsPassed) {
+    long long end = now();
+    values[METRIC_TURNS] += turnsPassed;
+    values[METRIC_HEAP_LIVE_BYTES] = (double)AllocationStats::getLiveBytes();
+    if (lastTurnEnd >= 0 && end > lastTurnEnd) {
+        values[METRIC_TURN_RATE] = turnsPassed * 1e9 / (end - lastTurnEnd);
+    }
+    lastTurnEnd = end;
+
+    int slot = (historyStart + historyCount) % METRIC_HISTORY_TURNS;
+    if (historyCount == METRIC_HISTORY_TURNS) {
+        historyStart = (historyStart + 1) % METRIC_HISTORY_TURNS;
+    } else {
+        historyCount++;
+    }
+    MetricTurnSample& sample = history[slot];
+    sample.turn = (int)values[METRIC_TURNS];
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        if (METRIC_INFO[m].kind == METRIC_GAUGE) {
+            sample.values[m] = values[m];
+            sample.sums[m] = 0;
+        } else {
+            sample.values[m] = values[m] - turnStartValues[m];
+            sample.sums[m] = sums[m] - turnStartSums[m];
+        }
+        turnStartValues[m] = values[m];
+        turnStartSums[m] = sums[m];
+    }
+    turnsClosed++;
+
+    if (exporting && turnsClosed % exportInterval == 0) {
+        exportNow();
+    }
+}
+
+bool Metrics::writeCsv() {
+    FILE* out = fopen((filePrefix + ".csv").c_str(), "a");
+    if (!out) {
+        return false;
+    }
+    for (int i = 0; i < historyCount; i++) {
+        const MetricTurnSample& sample = history[(historyStart + i) % METRIC_HISTORY_TURNS];
+        fprintf(out, "%lld,%d", runId, sample.turn);
+        for (int m = 0; m < METRIC_COUNT; m++) {
+            fprintf(out, ",%.10g", sample.values[m]);
+            if (METRIC_INFO[m].kind == METRIC_HISTOGRAM) {
+                fprintf(out, ",%.10g", sample.sums[m]);
+            }
+        }
+        fprintf(out, "\n");
+    }
+    fclose(out);
+    historyStart = (historyStart + historyCount) % METRIC_HISTORY_TURNS;
+    historyCount = 0;
+    return true;
+}
+
+bool Metrics::writePrometheus() {
+    FILE* out = fopen((filePrefix + ".prom").c_str(), "w");
+    if (!out) {
+        return false;
+    }
+    static const char* KIND_NAMES[] = { "counter", "gauge", "histogram" };
+    for (int m = 0; m < METRIC_COUNT; m++) {
+        const MetricInfo& info = METRIC_INFO[m];
+        fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", info.name, info.help, info.name, KIND_NAMES[info.kind]);
+        if (info.kind != METRIC_HISTOGRAM) {
+            fprintf(out, "%s %.10g\n", info.name, values[m]);
+            continue;
+        }
+        long long cumulative = 0;
+        for (int b = 0; b < METRIC_BUCKETS - 1; b++) {
+            cumulative += buckets[m][b];
+            fprintf(out, "%s_bucket{le=\"%g\"} %lld\n", info.name, BUCKET_BOUNDS[b], cumulative);
+        }
+        cumulative += buckets[m][METRIC_BUCKETS - 1];
+        fprintf(out, "%s_bucket{le=\"+Inf\"} %lld\n", info.name, cumulative);
+        fprintf(out, "%s_sum %.10g\n%s_count %lld\n", info.name, sums[m], info.name, cumulative);
+    }
+    fclose(out);
+    return true;
+}
+
+bool Metrics::exportNow() {
+    if (!exporting) {
+        return false;
+    }
+    bool csvWritten = writeCsv();
+    bool promWritten = writePrometheus();
+    if (!csvWritten || !promWritten) {
+        cout << "Could not write metrics to " << filePrefix << ".csv/.prom" << endl;
+        return false;
+    }
+    return true;
+}
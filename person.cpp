@@ -0,0 +1,29 @@
+#include "Stronghold.h"
+
+Person::Person() {
+    personName = "Unknown";
+    personAge = 0;
+}
+
+Person::Person(string n, int a) {
+    personName = n;
+    personAge = a;
+}
+
+void Person::display() const {
+    cout << personName << " (age " << personAge << ")\n";
+}
+
+SocialClass::SocialClass() {
+    classTitle = "Unknown";
+    classSize = 0;
+}
+
+SocialClass::SocialClass(string t, int pop) {
+    classTitle = t;
+    classSize = pop;
+}
+
+void SocialClass::showStatus() const {
+    cout << classTitle << ": " << classSize << " citizens\n";
+}
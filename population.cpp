@@ -6,6 +6,38 @@
 
 using namespace std;
 
+// Yearly chance of dying in each 5-year age band
+const float BAND_MORTALITY[AGE_BANDS] = {
+    0.020f, 0.003f, 0.002f, 0.003f, 0.004f, 0.005f, 0.006f, 0.008f,
+    0.011f, 0.015f, 0.021f, 0.030f, 0.045f, 0.070f, 0.110f, 0.200f
+};
+
+// Yearly births per person in each age band
+const float BAND_FERTILITY[AGE_BANDS] = {
+    0.0f, 0.0f, 0.0f, 0.040f, 0.070f, 0.060f, 0.040f, 0.020f,
+    0.005f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f
+};
+
+// Share of each band that grows into the next band every year
+const float BAND_AGING[AGE_BANDS] = {
+    0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f,
+    0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.2f, 0.0f
+};
+
+// 1 for bands of working adults (20-64), who are the ones changing class
+const float BAND_ADULT[AGE_BANDS] = {
+    0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f
+};
+
+// Richer classes live longer and have fewer children
+const float CLASS_MORTALITY_SCALE[SOCIAL_CLASS_COUNT] = { 1.15f, 1.0f, 0.8f };
+const float CLASS_FERTILITY_SCALE[SOCIAL_CLASS_COUNT] = { 1.1f, 1.0f, 0.8f };
+
+// Yearly chance for an adult to rise into the next class or fall into the one below
+const float UPWARD_MOBILITY[SOCIAL_CLASS_COUNT] = { 0.004f, 0.002f, 0.0f };
+const float DOWNWARD_MOBILITY[SOCIAL_CLASS_COUNT] = { 0.0f, 0.002f, 0.003f };
+
 Population::Population()
 {
     totalPopulation = 100;
@@ -14,11 +46,176 @@ Population::Population()
     nobleCount = 15;
     citizenHappiness = 70.0;
     foodReserves = 300.0;
+    rebuildCohorts();
+}
+
+// Spreads class counts over a typical age pyramid
+static void spreadOverPyramid(float* cohortData, const int* classCounts)
+{
+    float pyramid[AGE_BANDS];
+    float pyramidTotal = 0;
+    float share = 1.0f;
+    for (int b = 0; b < AGE_BANDS; b++) {
+        pyramid[b] = share;
+        pyramidTotal += share;
+        share *= (1.0f - BAND_MORTALITY[b] * YEARS_PER_BAND) * 0.95f;
+    }
+
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        for (int b = 0; b < AGE_BANDS; b++) {
+            cohortData[c * AGE_BANDS + b] = classCounts[c] * pyramid[b] / pyramidTotal;
+        }
+    }
+}
+
+// Spreads the current class counts over a typical age pyramid
+void Population::rebuildCohorts()
+{
+    int classCounts[SOCIAL_CLASS_COUNT] = { peasantCount, merchantCount, nobleCount };
+    spreadOverPyramid(cohorts, classCounts);
+    syncCountsFromCohorts();
+}
+
+// Works out the class shares and recruitable count again after a change
+void Population::refreshDerived() const
+{
+    int classCounts[SOCIAL_CLASS_COUNT] = { peasantCount, merchantCount, nobleCount };
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        classRatios[c] = totalPopulation > 0 ? (float)classCounts[c] / totalPopulation : 0.0f;
+    }
+    float recruitable = 0;
+    for (int b = 3; b < 9; b++) {
+        recruitable += cohorts[CLASS_PEASANT * AGE_BANDS + b];
+        recruitable += cohorts[CLASS_MERCHANT * AGE_BANDS + b];
+    }
+    recruitableCount = (int)(recruitable * 0.5f);
+    derivedDirty = false;
+}
+
+void Population::syncCountsFromCohorts()
+{
+    float classTotals[SOCIAL_CLASS_COUNT] = { 0, 0, 0 };
+    for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+        for (int b = 0; b < AGE_BANDS; b++) {
+            classTotals[c] += cohorts[c * AGE_BANDS + b];
+        }
+    }
+    peasantCount = (int)(classTotals[CLASS_PEASANT] + 0.5f);
+    merchantCount = (int)(classTotals[CLASS_MERCHANT] + 0.5f);
+    nobleCount = (int)(classTotals[CLASS_NOBLE] + 0.5f);
+    totalPopulation = peasantCount + merchantCount + nobleCount;
+    derivedDirty = true;
+}
+
+// Grows or shrinks every cohort by the same factor
+void Population::scaleCohorts(int newTotal)
+{
+    fitCohorts(cohorts, newTotal);
+    syncCountsFromCohorts();
+}
+
+// Brings one kingdom's cohorts to a new head count by scaling them all
+// alike. Empty cohorts get the usual class split on a typical pyramid
+void Population::fitCohorts(float* cohortData, int total)
+{
+    if (total < 0) total = 0;
+    float current = cohortTotal(cohortData);
+    if (current <= 0) {
+        int classCounts[SOCIAL_CLASS_COUNT];
+        classCounts[CLASS_PEASANT] = total * 0.6;
+        classCounts[CLASS_MERCHANT] = total * 0.25;
+        classCounts[CLASS_NOBLE] = total - classCounts[CLASS_PEASANT] - classCounts[CLASS_MERCHANT];
+        spreadOverPyramid(cohortData, classCounts);
+        return;
+    }
+    float factor = total / current;
+    for (int i = 0; i < COHORTS_PER_KINGDOM; i++) {
+        cohortData[i] *= factor;
+    }
+}
+
+float Population::cohortTotal(const float* cohortData)
+{
+    float total = 0;
+    for (int i = 0; i < COHORTS_PER_KINGDOM; i++) {
+        total += cohortData[i];
+    }
+    return total;
+}
+
+// Moves one kingdom's cohorts forward by a year
+void Population::advanceCohorts()
+{
+    advanceCohortBatch(cohorts, &citizenHappiness, 1);
+    syncCountsFromCohorts();
+}
+
+// Ages many kingdoms at once. cohortData holds COHORTS_PER_KINGDOM floats per
+// kingdom back to back; every inner loop runs over a fixed-size band array
+// so the compiler can turn it into vector instructions
+void Population::advanceCohortBatch(float* cohortData, const float* happiness, int kingdomCount)
+{
+    for (int k = 0; k < kingdomCount; k++) {
+        float* kingdom = cohortData + k * COHORTS_PER_KINGDOM;
+        float fertilityBoost = 0.5f + happiness[k] / 100.0f;
+
+        // Class changes are worked out from last year's numbers first
+        float risers[SOCIAL_CLASS_COUNT][AGE_BANDS];
+        float fallers[SOCIAL_CLASS_COUNT][AGE_BANDS];
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            const float* row = kingdom + c * AGE_BANDS;
+            for (int b = 0; b < AGE_BANDS; b++) {
+                risers[c][b] = row[b] * BAND_ADULT[b] * UPWARD_MOBILITY[c];
+                fallers[c][b] = row[b] * BAND_ADULT[b] * DOWNWARD_MOBILITY[c];
+            }
+        }
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            float* row = kingdom + c * AGE_BANDS;
+            for (int b = 0; b < AGE_BANDS; b++) {
+                float arriving = 0;
+                if (c > 0) arriving += risers[c - 1][b];
+                if (c < SOCIAL_CLASS_COUNT - 1) arriving += fallers[c + 1][b];
+                row[b] += arriving - risers[c][b] - fallers[c][b];
+            }
+        }
+
+        // Births, deaths and getting older; children keep their parents' class
+        for (int c = 0; c < SOCIAL_CLASS_COUNT; c++) {
+            float* row = kingdom + c * AGE_BANDS;
+            float births = 0;
+            float survivors[AGE_BANDS];
+            for (int b = 0; b < AGE_BANDS; b++) {
+                births += row[b] * BAND_FERTILITY[b];
+                survivors[b] = row[b] * (1.0f - BAND_MORTALITY[b] * CLASS_MORTALITY_SCALE[c]);
+            }
+            births *= CLASS_FERTILITY_SCALE[c] * fertilityBoost;
+
+            row[0] = survivors[0] * (1.0f - BAND_AGING[0]) + births;
+            for (int b = 1; b < AGE_BANDS; b++) {
+                row[b] = survivors[b] * (1.0f - BAND_AGING[b]) + survivors[b - 1] * BAND_AGING[b - 1];
+            }
+        }
+    }
+}
+
+// Fighting-age men (15-44) among peasants and merchants
+int Population::getRecruitableCount() const
+{
+    if (derivedDirty) refreshDerived();
+    return recruitableCount;
+}
+
+// Share of the population in a social class, from 0 to 1
+float Population::getClassRatio(int socialClass) const
+{
+    if (derivedDirty) refreshDerived();
+    return classRatios[socialClass];
 }
 
 // Simulates population changes like births, deaths, and class balance
 void Population::simulate()
 {
+    ALLOCATION_SCOPE(SUBSYSTEM_POPULATION);
     cout << "\n==================================================\n";
     cout << "                    POPULATION MANAGEMENT          \n";
     cout << "==================================================\n";
@@ -64,8 +261,7 @@ void Population::simulate()
                 cin >> newGrowth;
                 
                 if (newGrowth >= -10 && newGrowth <= 20) {
-                    totalPopulation += newGrowth;
-                    if (totalPopulation < 0) totalPopulation = 0;
+                    scaleCohorts(totalPopulation + newGrowth);
                     cout << "Population growth adjusted.\n";
                 } else {
                     cout << "Invalid growth rate!\n";
@@ -74,9 +270,9 @@ void Population::simulate()
             break;
         }
         case 3: {
-            float peasantRatio = (float)peasantCount / totalPopulation;
-            float merchantRatio = (float)merchantCount / totalPopulation;
-            float nobleRatio = (float)nobleCount / totalPopulation;
+            float peasantRatio = getClassRatio(CLASS_PEASANT);
+            float merchantRatio = getClassRatio(CLASS_MERCHANT);
+            float nobleRatio = getClassRatio(CLASS_NOBLE);
             
             cout << "\nCurrent Class Distribution:\n";
             cout << "- Peasants: " << (peasantRatio * 100) << "%\n";
@@ -103,15 +299,15 @@ void Population::simulate()
             cout << "Invalid choice!\n";
     }
     
-    // Update class distribution
-    peasantCount = totalPopulation * 0.6;
-    merchantCount = totalPopulation * 0.25;
-    nobleCount = totalPopulation * 0.15;
+    // A year passes: births, deaths and people moving between classes.
+    // Traced from here on, so time spent at the prompts is left out
+    TRACE_SCOPE("Population::simulate");
+    advanceCohorts();
     
     if (citizenHappiness < 30) {
         cout << "Alert: Civil unrest detected!\n";
         int unrestCasualties = rand() % 10;
-        totalPopulation -= unrestCasualties;
+        decrease(unrestCasualties);
         cout << "Casualties from unrest: " << unrestCasualties << " citizens\n";
     }
     
@@ -121,16 +317,18 @@ void Population::simulate()
 // Shows current population stats
 void Population::showStats() const
 {
-    cout << "\n==================================================\n";
-    cout << "                    POPULATION STATISTICS          \n";
-    cout << "==================================================\n";
-    cout << "Total Citizens: " << totalPopulation << "\n";
-    cout << "Peasant Class: " << peasantCount << "\n";
-    cout << "Merchant Class: " << merchantCount << "\n";
-    cout << "Noble Class: " << nobleCount << "\n";
-    cout << "Happiness Index: " << citizenHappiness << "%\n";
-    cout << "Food Reserves: " << foodReserves << " units\n";
-    cout << "==================================================\n";
+    ScreenBuffer& screen = ScreenBuffer::console();
+    screen << "\n==================================================\n";
+    screen << "                    POPULATION STATISTICS          \n";
+    screen << "==================================================\n";
+    screen << "Total Citizens: " << totalPopulation << "\n";
+    screen << "Peasant Class: " << peasantCount << "\n";
+    screen << "Merchant Class: " << merchantCount << "\n";
+    screen << "Noble Class: " << nobleCount << "\n";
+    screen << "Happiness Index: " << citizenHappiness << "%\n";
+    screen << "Food Reserves: " << foodReserves << " units\n";
+    screen << "==================================================\n";
+    screen.present();
 }
 
 // Saves population data to a file
@@ -149,6 +347,9 @@ void Population::saveToFile() const
     out << nobleCount << endl;
     out << citizenHappiness << endl;
     out << foodReserves << endl;
+    for (int i = 0; i < COHORTS_PER_KINGDOM; i++) {
+        out << cohorts[i] << (i + 1 < COHORTS_PER_KINGDOM ? " " : "\n");
+    }
     out.close();
     cout << "\nPopulation data successfully archived.\n";
 }
@@ -164,6 +365,15 @@ void Population::loadFromFile()
     }
 
     in >> totalPopulation >> peasantCount >> merchantCount >> nobleCount >> citizenHappiness >> foodReserves;
+    // Older saves have no age data, so build it from the class counts
+    for (int i = 0; i < COHORTS_PER_KINGDOM && in; i++) {
+        in >> cohorts[i];
+    }
+    if (in) {
+        syncCountsFromCohorts();
+    } else {
+        rebuildCohorts();
+    }
     in.close();
     cout << "\nPopulation data successfully restored.\n";
 }
@@ -174,16 +384,8 @@ int Population::getTotal() const
     return totalPopulation;
 }
 
-// Decreases population by given amount and updates class distribution
+// Decreases population by given amount, taken evenly from every cohort
 void Population::decrease(int amount)
 {
-    totalPopulation -= amount;
-    if (totalPopulation < 0)
-    {
-        totalPopulation = 0;
-    }
-
-    peasantCount = totalPopulation * 0.6;
-    merchantCount = totalPopulation * 0.25;
-    nobleCount = totalPopulation * 0.15;
+    scaleCohorts(totalPopulation - amount);
 }
@@ -1,10 +1,53 @@
 #include "Stronghold.h"
 
+// What the realm gathers and uses up every turn
+const int FOOD_GATHERED_PER_TURN = 20;
+const int TIMBER_GATHERED_PER_TURN = 15;
+const int STONE_GATHERED_PER_TURN = 10;
+const int METAL_GATHERED_PER_TURN = 5;
+const int FOOD_USED_PER_TURN = 10;
+const int TIMBER_USED_PER_TURN = 5;
+const int STONE_USED_PER_TURN = 3;
+const int METAL_USED_PER_TURN = 2;
+
 ResourceManager::ResourceManager() {
     foodStock = 500;
     timberStock = 300;
     stoneStock = 200;
     metalStock = 100;
+    lastUpdatedTurn = GameClock::now();
+}
+
+int ResourceManager::turnsSinceUpdate() const {
+    int turns = GameClock::now() - lastUpdatedTurn;
+    return turns > 0 ? turns : 0;
+}
+
+// Adds the growth since the last update to the stocks, so a change can be
+// made on top of the current amounts
+void ResourceManager::settle() {
+    int turns = turnsSinceUpdate();
+    foodStock += (FOOD_GATHERED_PER_TURN - FOOD_USED_PER_TURN) * turns;
+    timberStock += (TIMBER_GATHERED_PER_TURN - TIMBER_USED_PER_TURN) * turns;
+    stoneStock += (STONE_GATHERED_PER_TURN - STONE_USED_PER_TURN) * turns;
+    metalStock += (METAL_GATHERED_PER_TURN - METAL_USED_PER_TURN) * turns;
+    lastUpdatedTurn = GameClock::now();
+}
+
+int ResourceManager::getFoodStock() const {
+    return foodStock + (FOOD_GATHERED_PER_TURN - FOOD_USED_PER_TURN) * turnsSinceUpdate();
+}
+
+int ResourceManager::getTimberStock() const {
+    return timberStock + (TIMBER_GATHERED_PER_TURN - TIMBER_USED_PER_TURN) * turnsSinceUpdate();
+}
+
+int ResourceManager::getStoneStock() const {
+    return stoneStock + (STONE_GATHERED_PER_TURN - STONE_USED_PER_TURN) * turnsSinceUpdate();
+}
+
+int ResourceManager::getMetalStock() const {
+    return metalStock + (METAL_GATHERED_PER_TURN - METAL_USED_PER_TURN) * turnsSinceUpdate();
 }
 
 void ResourceManager::manage() {
@@ -17,6 +60,7 @@ void ResourceManager::manage() {
     int stoneGathered = 20;
     int metalGathered = 10;
     
+    settle();
     foodStock += foodGathered;
     timberStock += timberGathered;
     stoneStock += stoneGathered;
@@ -30,32 +74,36 @@ void ResourceManager::manage() {
     cout << "==================================================\n";
 }
 
-// Gathers new resources
+// Gathers one extra turn's worth of resources
 void ResourceManager::gatherResources() {
-    foodStock += 20;
-    timberStock += 15;
-    stoneStock += 10;
-    metalStock += 5;
+    settle();
+    foodStock += FOOD_GATHERED_PER_TURN;
+    timberStock += TIMBER_GATHERED_PER_TURN;
+    stoneStock += STONE_GATHERED_PER_TURN;
+    metalStock += METAL_GATHERED_PER_TURN;
 }
 
-// Consumes resources for various needs
+// Uses up one extra turn's worth of resources
 void ResourceManager::consumeResources() {
-    foodStock -= 10;
-    timberStock -= 5;
-    stoneStock -= 3;
-    metalStock -= 2;
+    settle();
+    foodStock -= FOOD_USED_PER_TURN;
+    timberStock -= TIMBER_USED_PER_TURN;
+    stoneStock -= STONE_USED_PER_TURN;
+    metalStock -= METAL_USED_PER_TURN;
 }
 
 // Shows current resource levels
 void ResourceManager::showStats() const {
-    cout << "\n==================================================\n";
-    cout << "                    RESOURCE OVERVIEW             \n";
-    cout << "==================================================\n";
-    cout << "Food: " << foodStock << " units\n";
-    cout << "Wood: " << timberStock << " units\n";
-    cout << "Stone: " << stoneStock << " units\n";
-    cout << "Metal: " << metalStock << " units\n";
-    cout << "==================================================\n";
+    ScreenBuffer& screen = ScreenBuffer::console();
+    screen << "\n==================================================\n";
+    screen << "                    RESOURCE OVERVIEW             \n";
+    screen << "==================================================\n";
+    screen << "Food: " << getFoodStock() << " units\n";
+    screen << "Wood: " << getTimberStock() << " units\n";
+    screen << "Stone: " << getStoneStock() << " units\n";
+    screen << "Metal: " << getMetalStock() << " units\n";
+    screen << "==================================================\n";
+    screen.present();
 }
 
 // Saves resource data to a file
@@ -66,10 +114,10 @@ void ResourceManager::saveToFile() const {
         return;
     }
     
-    out << foodStock << endl;
-    out << timberStock << endl;
-    out << stoneStock << endl;
-    out << metalStock << endl;
+    out << getFoodStock() << endl;
+    out << getTimberStock() << endl;
+    out << getStoneStock() << endl;
+    out << getMetalStock() << endl;
     out.close();
     cout << "Resource records archived successfully.\n";
 }
@@ -83,12 +131,15 @@ void ResourceManager::loadFromFile() {
     }
     
     in >> foodStock >> timberStock >> stoneStock >> metalStock;
+    lastUpdatedTurn = GameClock::now();
     in.close();
     cout << "Resource records restored successfully.\n";
 }
 
 // Consumes a specific amount of a resource
 void ResourceManager::consumeFixed(string resourceType, int amount) {
+    ALLOCATION_SCOPE(SUBSYSTEM_RESOURCES);
+    settle();
     if (resourceType == "food") {
         foodStock -= amount;
     } else if (resourceType == "wood") {
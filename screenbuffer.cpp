@@ -0,0 +1,198 @@
+#include "Stronghold.h"
+#include <cstdio>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+
+// Passes cout's output through unchanged while counting how far it moves
+// the cursor down. cin flushes cout before every read, and the player's
+// Enter adds a line, so each flush counts as one more
+class LineCountingBuf : public streambuf {
+private:
+    streambuf* target;
+    int& lines;
+
+protected:
+    int overflow(int c) {
+        if (c == EOF) {
+            return 0;
+        }
+        if (c == '\n') lines++;
+        return target->sputc((char)c);
+    }
+
+    streamsize xsputn(const char* text, streamsize count) {
+        for (streamsize i = 0; i < count; i++) {
+            if (text[i] == '\n') lines++;
+        }
+        return target->sputn(text, count);
+    }
+
+    int sync() {
+        lines++;
+        return target->pubsync();
+    }
+
+public:
+    LineCountingBuf(streambuf* realBuf, int& lineCounter) : target(realBuf), lines(lineCounter) {
+    }
+};
+
+ScreenBuffer::ScreenBuffer()
+    : redraw(false), holdDepth(0), linesBelowFrame(0), consoleBuf(0), countingBuf(0) {
+}
+
+ScreenBuffer::~ScreenBuffer() {
+    setRedraw(false);
+}
+
+// The one buffer every screen of the game writes through
+ScreenBuffer& ScreenBuffer::console() {
+    static ScreenBuffer screen;
+    return screen;
+}
+
+// Redraw mode counts what cout prints so it can tell when the terminal
+// has scrolled the last frame away
+void ScreenBuffer::setRedraw(bool enabled) {
+    if (enabled == redraw) {
+        return;
+    }
+    redraw = enabled;
+    lastFrame.clear();
+    if (enabled) {
+        consoleBuf = cout.rdbuf();
+        countingBuf = new LineCountingBuf(consoleBuf, linesBelowFrame);
+        cout.rdbuf(countingBuf);
+    } else {
+        cout.rdbuf(consoleBuf);
+        delete countingBuf;
+        countingBuf = 0;
+        consoleBuf = 0;
+    }
+}
+
+// Screens presented between hold() and release() go out together
+void ScreenBuffer::hold() {
+    holdDepth++;
+}
+
+void ScreenBuffer::release() {
+    if (holdDepth > 0 && --holdDepth == 0) {
+        present();
+    }
+}
+
+string ScreenBuffer::takePending() {
+    string text = pending.str();
+    pending.str("");
+    pending.clear();
+    return text;
+}
+
+// Anything cout still holds goes first so the order on screen is kept
+void ScreenBuffer::writeOut(const string& text) {
+    if (consoleBuf) {
+        consoleBuf->pubsync();
+    } else {
+        cout.flush();
+    }
+    fflush(stdout);
+    if (text.empty()) {
+        return;
+    }
+#ifdef _WIN32
+    fwrite(text.data(), 1, text.size(), stdout);
+    fflush(stdout);
+#else
+    size_t written = 0;
+    while (written < text.size()) {
+        ssize_t result = ::write(STDOUT_FILENO, text.data() + written, text.size() - written);
+        if (result <= 0) {
+            break;
+        }
+        written += (size_t)result;
+    }
+#endif
+}
+
+int ScreenBuffer::terminalRows() const {
+#ifndef _WIN32
+    struct winsize size;
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_row > 0) {
+        return size.ws_row;
+    }
+#endif
+    return 24;
+}
+
+// Writes what was composed at the cursor, in one go
+void ScreenBuffer::present() {
+    if (holdDepth > 0) {
+        return;
+    }
+    string text = takePending();
+    if (redraw) {
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '\n') linesBelowFrame++;
+        }
+    }
+    writeOut(text);
+}
+
+// Writes a whole screen. In redraw mode it goes to the top of the terminal
+// and only changed lines are sent; the cursor is left after the last line,
+// which is usually the prompt
+void ScreenBuffer::presentFrame() {
+    string text = takePending();
+    if (!redraw) {
+        writeOut(text);
+        return;
+    }
+
+    vector<string> lines;
+    size_t start = 0;
+    while (true) {
+        size_t end = text.find('\n', start);
+        if (end == string::npos) {
+            lines.push_back(text.substr(start));
+            break;
+        }
+        lines.push_back(text.substr(start, end - start));
+        start = end + 1;
+    }
+
+    string out;
+    bool scrolled = (int)(lastFrame.size() + linesBelowFrame) + 2 >= terminalRows();
+    if (lastFrame.empty() || scrolled) {
+        out = "\x1b[H\x1b[2J";
+        for (size_t i = 0; i < lines.size(); i++) {
+            out += lines[i];
+            if (i + 1 < lines.size()) out += "\n";
+        }
+    } else {
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (i >= lastFrame.size() || lastFrame[i] != lines[i]) {
+                out += "\x1b[" + to_string(i + 1) + ";1H" + lines[i] + "\x1b[K";
+            }
+        }
+        for (size_t i = lines.size(); i < lastFrame.size(); i++) {
+            out += "\x1b[" + to_string(i + 1) + ";1H\x1b[K";
+        }
+        out += "\x1b[" + to_string(lines.size()) + ";" + to_string(lines.back().size() + 1) + "H";
+    }
+    lastFrame = lines;
+    linesBelowFrame = 0;
+    writeOut(out);
+}
+
+// After the player answers the frame's prompt, whatever the previous action
+// left below the frame is cleared
+void ScreenBuffer::clearBelow() {
+    if (redraw) {
+        writeOut("\x1b[J");
+    }
+}
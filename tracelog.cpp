@@ -0,0 +1,124 @@
+#include "Stronghold.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+
+// Events kept per thread; once a buffer is full later events are counted
+// as dropped rather than overwriting the start of the trace
+const int TRACE_BUFFER_EVENTS = 1 << 16;
+
+struct TraceEvent {
+    const char* name;
+    long long start;     // Nanoseconds since tracing was switched on
+    long long duration;
+};
+
+// Written only by its own thread. count is published after each event, so
+// a dump running on another thread reads only finished events
+struct TraceBuffer {
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+    atomic<int> count;
+    atomic<long long> dropped;
+    int threadId;
+};
+
+bool TraceLog::enabled = false;
+string TraceLog::outputFile = "trace.json";
+
+static chrono::steady_clock::time_point traceEpoch = chrono::steady_clock::now();
+
+// Buffers are registered once per thread and live until the program ends.
+// The list is never destroyed so the dump at exit can still read it
+static mutex& bufferListLock() {
+    static mutex* lock = new mutex;
+    return *lock;
+}
+
+static vector<TraceBuffer*>& bufferList() {
+    static vector<TraceBuffer*>* buffers = new vector<TraceBuffer*>;
+    return *buffers;
+}
+
+static TraceBuffer* threadBuffer() {
+    static thread_local TraceBuffer* buffer = 0;
+    if (buffer == 0) {
+        buffer = new TraceBuffer;
+        buffer->count.store(0);
+        buffer->dropped.store(0);
+        lock_guard<mutex> guard(bufferListLock());
+        buffer->threadId = (int)bufferList().size() + 1;
+        bufferList().push_back(buffer);
+    }
+    return buffer;
+}
+
+// The trace is written when the program exits, and dump() can be called
+// at any time before that for a snapshot
+void TraceLog::enable(const string& fileName) {
+    if (!enabled) {
+        atexit(dumpAtExit);
+    }
+    outputFile = fileName;
+    traceEpoch = chrono::steady_clock::now();
+    enabled = true;
+}
+
+void TraceLog::dumpAtExit() {
+    dump(outputFile);
+}
+
+long long TraceLog::now() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - traceEpoch).count();
+}
+
+void TraceLog::record(const char* name, long long start, long long duration) {
+    TraceBuffer* buffer = threadBuffer();
+    int index = buffer->count.load(memory_order_relaxed);
+    if (index >= TRACE_BUFFER_EVENTS) {
+        buffer->dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    buffer->events[index].name = name;
+    buffer->events[index].start = start;
+    buffer->events[index].duration = duration;
+    buffer->count.store(index + 1, memory_order_release);
+}
+
+// Complete ("X") events with times in microseconds, one row per thread
+bool TraceLog::dump(const string& fileName) {
+    FILE* out = fopen(fileName.c_str(), "w");
+    if (!out) {
+        cout << "Could not write trace file " << fileName << endl;
+        return false;
+    }
+
+    vector<TraceBuffer*> buffers;
+    {
+        lock_guard<mutex> guard(bufferListLock());
+        buffers = bufferList();
+    }
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t b = 0; b < buffers.size(); b++) {
+        TraceBuffer* buffer = buffers[b];
+        int count = buffer->count.load(memory_order_acquire);
+        for (int i = 0; i < count; i++) {
+            const TraceEvent& event = buffer->events[i];
+            fprintf(out, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",\n", event.name, buffer->threadId, event.start / 1000.0, event.duration / 1000.0);
+            first = false;
+        }
+        long long dropped = buffer->dropped.load(memory_order_relaxed);
+        if (dropped > 0) {
+            fprintf(out, "%s{\"name\":\"dropped %lld events\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%d,\"ts\":%.3f}",
+                    first ? "" : ",\n", dropped, buffer->threadId, now() / 1000.0);
+            first = false;
+        }
+    }
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    fclose(out);
+    return true;
+}